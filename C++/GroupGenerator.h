@@ -6,9 +6,19 @@
 
 #include<NTL/mat_ZZ.h>
 #include<NTL/pair.h>
-#include<list>
+#include<unordered_map>
 
 void SmithNF(NTL::vec_ZZ& D, NTL::mat_ZZ& U, const NTL::mat_ZZ& A);
+void SmithNF(NTL::vec_ZZ& D, NTL::mat_ZZ& U,
+             const NTL::mat_ZZ& A, const NTL::ZZ& R);
+// Smith normal form modulo R (multiple of |det(A)|), U mod R
+void SmithNF(NTL::vec_ZZ& D, const NTL::mat_ZZ& A, const NTL::ZZ& R);
+void SmithNF(NTL::vec_ZZ& D, const NTL::mat_ZZ& A);
+// only diagonal elements D of Smith normal form (see SmithNF.cpp)
+void HermitNF(NTL::mat_ZZ& W, const NTL::mat_ZZ& A);
+void HermitNF(NTL::mat_ZZ& W, const NTL::mat_ZZ& A, const NTL::ZZ& D);
+// Hermite normal form modulo D (multiple of determinant of lattice
+// spanned by rows of A) (see HermitNF.cpp)
 
 template<class T>
 long GroupGenerator(NTL::Vec<NTL::Pair<T, long> >& G,
@@ -24,36 +34,52 @@ long GroupGenerator(NTL::Vec<NTL::Pair<T, long> >& G,
 //   operator*=(T& b, T& a) : group operation b *= a
 //   operator==(T& a, T& b) : equality of group elements
 //   power(T& b, T& a, long n) : b = a^n (n may be n<0)
+//   hash(T& a) : hash value (size_t) of a, such that
+//                a == b implies hash(a) == hash(b)
+// elements of subgroup S and candidates in P are indexed by
+// hash values, so that the group is enumerated in O(order) steps
 // reference: J. Buchmann and U. Vollmer
 //   "Binary Quadratic Forms" Algorithm 9.1
 {
-    long i,j,k,l(0),m(0);
+    long i,j,k,l(0),m(0),q(0);
     T f;
     NTL::Vec<T> F,H;
     NTL::Vec<NTL::Vec<long> > U;
     NTL::Vec<NTL::Pair<T, NTL::Vec<long> > > S;
-    std::list<T> L;
-    typename std::list<T>::iterator p;
+    NTL::Vec<long> r;// r[i] = 1 if P[i] is in S
+    std::unordered_multimap<size_t, long> X,Y;// hash -> index in S, P
+    std::unordered_multimap<size_t, long>::iterator p;
+    std::pair<decltype(p), decltype(p)> R;
+    size_t h;
     // find relation basis in Hermite Normal Form (HNF)
+    r.SetLength(P.length(), 0);
     for(i=0; i<P.length(); i++)
-        L.push_back(P[i]);
+        Y.emplace(hash(P[i]), i);
     S.SetLength(1);
     set(S[0].a);// unit element
     for(;; l++) {
-        for(i=m; i<S.length(); i++)
-            for(p = L.begin(); p != L.end();)
-                if(*p == S[i].a) p = L.erase(p);// equality
+        for(i=m; i<S.length(); i++) {
+            X.emplace(h = hash(S[i].a), i);
+            R = Y.equal_range(h);
+            for(p = R.first; p != R.second;)
+                if(P[p->second] == S[i].a) {// equality
+                    r[p->second] = 1;
+                    p = Y.erase(p);
+                }
                 else p++;
-        if(L.empty()) break;
-        F.append(f = L.front());
+        }
+        if(Y.empty()) break;
+        while(r[q]) q++;
+        F.append(f = P[q]);
         H.SetLength(0);
         k = m = S.length();
         for(;;) {
-            for(i=0; i<m; i++)
-                if(f == S[i].a) break;// equality
-            if(i<m) break;
+            R = X.equal_range(hash(f));
+            for(p = R.first; p != R.second; p++)
+                if(f == S[p->second].a) break;// equality
+            if(p != R.second) { i = p->second; break; }
             H.append(f);
-            f *= L.front();// group operation
+            f *= P[q];// group operation
         }
         U.SetLength(l+1);
         for(j=0; j<l; j++)
@@ -77,7 +103,8 @@ long GroupGenerator(NTL::Vec<NTL::Pair<T, long> >& G,
     for(i=0; i<l; i++)
         for(j=0; j<=i; j++)
             B[i][j] = U[i][j];// HNF
-    SmithNF(d,V,B);
+    NTL::ZZ e(S.length());// order of group = det(B)
+    SmithNF(d,V,B,e);
     for(k=d.length(); k>0; k--)
         if(d[k-1] > 1) break;
     G.SetLength(k);
@@ -4,10 +4,17 @@
 #include<NTL/mat_ZZ.h>
 using namespace NTL;
 
+#define HNF_MODULAR 8// use modular HNF if number of columns >= this
+#define HNF_TRIAL   3// number of trials to find non-zero determinant
+
+void HermitNF(mat_ZZ& W, const mat_ZZ& A, const ZZ& D);
+
 void HermitNF(mat_ZZ& W, const mat_ZZ& A)
 // A = matrix of shape (m,n) (m>=n)
 // W = Hermite Normal Form A, i.e.,
 //     lower triangular matrix of shape (n,n)
+// if n >= HNF_MODULAR, W is computed modulo determinant of
+// n random combinations of rows of A (if it is non-zero)
 // reference: H. Cohen
 //   "A Course in Computational Algebraic Number Theory"
 //    Algorithm 2.4.5
@@ -16,6 +23,21 @@ void HermitNF(mat_ZZ& W, const mat_ZZ& A)
     int i,j,k(m-1),l;
     ZZ d,s,t,u,v,b;
     if(m<n) Error("m<n in HermitNF");
+    if(n >= HNF_MODULAR) {
+        mat_ZZ B;
+        B.SetDims(n,n);
+        for(l=0; l<HNF_TRIAL; l++) {
+            for(i=0; i<n; i++) {
+                B[i] = A[m-n+i];
+                for(j=0; j<m-n; j++)
+                    if(RandomBnd(2)) B[i] += A[j];
+            }
+            determinant(d,B);
+            if(IsZero(d)) continue;
+            HermitNF(W,A,d);
+            return;
+        }
+    }
     if(&W!=&A) W=A;
     for(l=n-1; l>=0; l--) {
         for(i=k-1; i>=0; i--) {
@@ -51,4 +73,72 @@ void HermitNF(mat_ZZ& W, const mat_ZZ& A)
         for(j=0; j<=i; j++)
             W[i][j] = W[k][j];
     W.SetDims(n,n);
-}
\ No newline at end of file
+}
+void HermitNF(mat_ZZ& W, const mat_ZZ& A, const ZZ& D)
+// A = matrix of shape (m,n) (m>=n) of rank n
+// D = non-zero multiple of determinant of lattice L
+//     spanned by rows of A
+// W = Hermite Normal Form A (same as HermitNF(W,A))
+// since L contains D*(unit vectors), entries are reduced modulo D.
+// when l-th diagonal element d = gcd(B[k][l], D) is found,
+// D is replaced by D/d, which is a multiple of determinant of
+// remaining (l x l) part of L, so that entries are kept
+// to the size of D.
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    Algorithm 2.4.8 (Domich, Kannan and Trotter)
+{
+    long m(A.NumRows()),n(A.NumCols());
+    long i,j,k(m-1),l;
+    ZZ R,d,s,t,u,v,b;
+    mat_ZZ B(A);
+    if(m<n) Error("m<n in HermitNF");
+    abs(R,D);
+    W.SetDims(n,n);
+    for(i=0; i<m; i++)
+        for(j=0; j<n; j++)
+            rem(B[i][j], B[i][j], R);
+    for(l=n-1; l>=0; l--) {
+        for(i=k-1; i>=0; i--) {
+            if(IsZero(B[i][l])) continue;
+            XGCD(d,u,v, B[i][l], B[k][l]);
+            div(s, B[k][l], d);
+            div(t, B[i][l], d);
+            B[k][l] = d;
+            clear(B[i][l]);
+            for(j=0; j<l; j++) {
+                mul(b, u, B[i][j]);
+                MulAddTo(b, v, B[k][j]);
+                B[i][j] *= s;
+                MulSubFrom(B[i][j], t, B[k][j]);
+                rem(B[i][j], B[i][j], R);
+                rem(B[k][j], b, R);
+            }
+        }
+        // W[l] = u*B[k] + v*R*(l-th unit vector), d = gcd(B[k][l],R)
+        XGCD(d,u,v, B[k][l], R);
+        for(j=0; j<l; j++) {
+            mul(b, u, B[k][j]);
+            rem(W[l][j], b, R);
+        }
+        W[l][l] = d;
+        for(j=l+1; j<n; j++) clear(W[l][j]);
+        // B[k] -= (B[k][l]/d)*W[l], so that B[k][l] = 0
+        div(s, B[k][l], d);
+        for(j=0; j<l; j++)
+            MulSubFrom(B[k][j], s, W[l][j]);
+        clear(B[k][l]);
+        R /= d;
+        for(i=0; i<m; i++)
+            for(j=0; j<l; j++)
+                rem(B[i][j], B[i][j], R);
+    }
+    // reduce entries below diagonal
+    for(i=1; i<n; i++) {
+        for(l=i-1; l>=0; l--) {
+            div(s, W[i][l], W[l][l]);
+            for(j=0; j<=l; j++)
+                MulSubFrom(W[i][j], s, W[l][j]);
+        }
+    }
+}
@@ -2,15 +2,17 @@
 //   http://www.shoup.net/ntl
 
 #include "IDL2.h"
-#include<NTL/mat_ZZ.h>
+#include "WindowPower.h"
+#include<cmath>
+#include<unordered_map>
 #include<exception>
 using namespace NTL;
 
-ZZ IDL2::S;// floor(sqrt(D)) (used only for D>0)
-ZZ IDL2::W;// floor(w) (used only for D>0)
-ZZ IDL2::W1;// floor(-conj(w)) (used only for D>0)
-
-void HermitNF(mat_ZZ&, const mat_ZZ&);
+thread_local ZZ IDL2::S;// floor(sqrt(D)) (used only for D>0)
+thread_local ZZ IDL2::W;// floor(w) (used only for D>0)
+thread_local ZZ IDL2::W1;// floor(-conj(w)) (used only for D>0)
+thread_local LRUCache<Pair<ZZ2, long> > IDL2::UnitCache;
+thread_local LRUCache<PrincipalCycle> IDL2::CycleCache(4);
 
 void IDL2::init(const ZZ& D) {// set discriminant
     if(sign(D) < 0) { ZZ2::init(D); return; }
@@ -21,6 +23,12 @@ void IDL2::init(const ZZ& D) {// set discriminant
     sub(W1, S, ZZ2::Dm4); W1 >>= 1;// -conj(w)
 }
 
+IDL2Context::IDL2Context(const ZZ& D_) {// context for D_
+    IDL2Push p;
+    IDL2::init(D_);
+    *this = IDL2Context();
+}
+
 IDL2::IDL2(const ZZ2& a) { conv(*this, a); }// principal ideal (a)
 IDL2::IDL2(const ZZ& a) { conv(*this, a); }// principal ideal (a)
 IDL2::IDL2(long a) { conv(*this, a); }// principal ideal (a)
@@ -37,37 +45,50 @@ void conj(IDL2& B, const IDL2& A) {// B = conjugate of A, 0<=B.b.y<B.a
     if(sign(B.b.x) < 0) B.b.x += B.a;
 }
 
+static void hnf(IDL2& A, const ZZ2& p, const ZZ2& q)
+// A = lattice pZ + qZ in hermite normal form,
+// assume p and q are linearly independent.
+// A.b.y = gcd(p.y, q.y), A.a = |det(p,q)|/A.b.y
+{
+    ZZ d,u,v,x;
+    XGCD(d,u,v,p.y,q.y);// u*p.y + v*q.y = d
+    mul(x, u, p.x);
+    MulAddTo(x, v, q.x);
+    mul(u, p.x, q.y);
+    MulSubFrom(u, q.x, p.y);
+    div(A.a, u, d);
+    abs(A.a, A.a);
+    rem(A.b.x, x, A.a);
+    A.b.y = d;
+}
+
 void conv(IDL2& A, const ZZ2& a) {// principal ideal A = (a)
     if(IsZero(a.y)) { conv(A, a.x); return; }
     ZZ2 b;
-    mat_ZZ W;
-    W.SetDims(2,2);
     mul_w(b,a);
-    W[0][0] = a.x;
-    W[0][1] = a.y;
-    W[1][0] = b.x;
-    W[1][1] = b.y;
-    HermitNF(W,W);
-    A.a = W[0][0];
-    A.b.x = W[1][0];
-    A.b.y = W[1][1];
+    hnf(A,a,b);
 }
 
-void add(IDL2& C, const IDL2& A, const IDL2& B) {// C = A+B
+void add(IDL2& C, const IDL2& A, const IDL2& B)
+// C = A+B
+// A.b.y and B.b.y are combined by XGCD to give C.b.y,
+// then C.a = gcd(A.a, B.a, x-component of the combination
+// of A.b and B.b which eliminates y-component)
+{
     if(IsZero(A)) { if(&C!=&B) C=B; return; }
     if(IsZero(B)) { if(&C!=&A) C=A; return; }
-    mat_ZZ W;
-    W.SetDims(4,2);
-    W[0][0] = A.a;
-    W[1][0] = A.b.x;
-    W[1][1] = A.b.y;
-    W[2][0] = B.a;
-    W[3][0] = B.b.x;
-    W[3][1] = B.b.y;
-    HermitNF(W,W);
-    C.a = W[0][0];
-    C.b.x = W[1][0];
-    C.b.y = W[1][1];
+    ZZ d,u,v,x,s,t;
+    XGCD(d,u,v,A.b.y,B.b.y);// u*A.b.y + v*B.b.y = d
+    mul(x, u, A.b.x);
+    MulAddTo(x, v, B.b.x);
+    div(s, B.b.y, d);
+    div(t, A.b.y, d);
+    mul(u, s, A.b.x);
+    MulSubFrom(u, t, B.b.x);
+    GCD(u, u, A.a);
+    GCD(C.a, u, B.a);
+    rem(C.b.x, x, C.a);
+    C.b.y = d;
 }
 
 void add(IDL2& B, const IDL2& A, const ZZ& a)
@@ -76,44 +97,132 @@ void add(IDL2& B, const IDL2& A, const ZZ& a)
 void add(IDL2& B, const IDL2& A, const ZZ2& a)
 { IDL2 C; conv(C,a); add(B,A,C); }// B = A+(a)
 
+static long IsInvertible(const ZZ& a, const ZZ& b, const ZZ& c)
+// test if primitive ideal aZ + (b+w)Z is invertible,
+// i.e. gcd(a, 2*b + (D mod 4), c) = 1 where c = norm(b+w)/a
+// (always invertible if D is fundamental)
+{
+    NTL_ZZRegister(s);
+    LeftShift(s, b, 1);
+    if(ZZ2::Dm4) s++;
+    GCD(s, s, a);
+    if(IsOne(s)) return 1;
+    GCD(s, s, c);
+    return IsOne(s);
+}
+
+long IsInvertible(const IDL2& A)
+// test if A is invertible, i.e. A*conj(A) = (norm(A))
+{
+    if(IsZero(A)) return 0;
+    NTL_ZZRegister(a);
+    NTL_ZZRegister(b);
+    NTL_ZZRegister(c);
+    div(a, A.a, A.b.y);
+    div(b, A.b.x, A.b.y);
+    sqr(c, b);
+    if(ZZ2::Dm4) c += b;
+    c -= ZZ2::D4;
+    c /= a;
+    return IsInvertible(a,b,c);
+}
+
+static void LatticeMul(IDL2& C, const ZZ& a1, const ZZ& b1,
+                       const ZZ& a2, const ZZ& b2)
+// C = (a1 Z + (b1+w)Z)*(a2 Z + (b2+w)Z) by hermite normal form
+// of generators, used if composition formula is not valid
+{
+    ZZ2 p,q,r,s;
+    IDL2 E;
+    set(p, a1*a2, 0);
+    set(q, a1*b2, a1);
+    hnf(C,p,q);
+    set(p, a2*b1, a2);
+    set(r, b1, 1);
+    set(s, b2, 1);
+    mul(q,r,s);
+    hnf(E,p,q);
+    add(C,C,E);
+}
+
+static void compose(IDL2& C, const IDL2& A, const IDL2& B)
+// C = A*B by composition of primitive parts of A and B.
+// let A = e1*(a1 Z + (b1+w)Z) and B = e2*(a2 Z + (b2+w)Z),
+// d1 = gcd(a1, a2, b1+b2+Dm4), then
+// A*B = e1*e2*d1*(a3 Z + (b3+w)Z), a3 = a1*a2/d1^2,
+// b3 = b2 + (a2/d1)*r, where r is given below.
+// if A==B, one XGCD is sufficient.
+// if d1>1 and A or B is not invertible (D is not fundamental),
+// the formula is not valid and LatticeMul is used instead.
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    Algorithm 5.4.7 and 5.4.8
+{
+    ZZ a1,a2,b1,b2,c2,s,n,d,d1,u,v,x,y;
+    div(a2, B.a, B.b.y);
+    div(b2, B.b.x, B.b.y);
+    sqr(c2, b2);
+    if(ZZ2::Dm4) c2 += b2;
+    c2 -= ZZ2::D4;
+    c2 /= a2;// c2 = norm(b2+w)/a2
+    if(&A==&B) {
+        a1 = a2;
+        LeftShift(s, b2, 1);
+        if(ZZ2::Dm4) s++;
+        XGCD(d1,x,y,s,a2);// x*s + y*a2 = d1
+        clear(n);
+    }
+    else {
+        div(a1, A.a, A.b.y);
+        div(b1, A.b.x, A.b.y);
+        add(s, b1, b2);
+        if(ZZ2::Dm4) s++;
+        sub(n, b2, b1);
+        XGCD(d,u,v,a2,a1);// u*a2 + v*a1 = d
+        n *= u;
+        if(IsOne(d)) { clear(x); d1 = d; }
+        else { XGCD(d1,x,y,s,d); n *= y; }// x*s + y*d = d1
+    }
+    if(!IsOne(d1) && (!IsInvertible(a2,b2,c2) ||
+                      (&A!=&B && !IsInvertible(A)))) {
+        mul(u, A.b.y, B.b.y);// content
+        LatticeMul(C, a1, (&A==&B ? b2 : b1), a2, b2);
+        C.a *= u;
+        C.b *= u;
+        return;
+    }
+    // r = -(u*y*n + x*c2) mod a1/d1
+    c2 *= x;
+    c2 += n;
+    a1 /= d1;
+    a2 /= d1;
+    NegateMod(c2, c2%a1, a1);
+    mul(C.b.x, a2, c2);
+    C.b.x += b2;
+    mul(C.b.y, A.b.y, B.b.y);
+    C.b.y *= d1;
+    mul(C.a, a1, a2);
+    C.b.x %= C.a;
+    C.a *= C.b.y;
+    C.b.x *= C.b.y;
+}
+
 void mul(IDL2& C, const IDL2& A, const IDL2& B) {// C = A*B
     if(IsZero(A) ||
        IsZero(B)) { clear(C); return; }
     if(IsUnit(A)) { if(&C!=&B) C=B; return; }
     if(IsUnit(B)) { if(&C!=&A) C=A; return; }
-    ZZ2 s;
-    mat_ZZ W;
-    W.SetDims(4,2);
-    mul(W[0][0], A.a, B.a);
-    mul(W[1][0], A.a, B.b.x);
-    mul(W[1][1], A.a, B.b.y);
-    mul(W[2][0], A.b.x, B.a);
-    mul(W[2][1], A.b.y, B.a);
-    mul(s, A.b, B.b);
-    W[3][0] = s.x;
-    W[3][1] = s.y;
-    HermitNF(W,W);
-    C.a = W[0][0];
-    C.b.x = W[1][0];
-    C.b.y = W[1][1];
+    compose(C,A,B);
 }
 
 void mul(IDL2& B, const IDL2& A, const ZZ2& a) {// B = A*(a)
     if(IsZero(A)) { clear(B); return; }
     if(IsUnit(A)) { conv(B,a); return; }
     if(IsZero(a.y)) { mul(B, A, a.x); return; }
-    ZZ2 s;
-    mat_ZZ W;
-    W.SetDims(2,2);
-    mul(W[0][0], A.a, a.x);
-    mul(W[0][1], A.a, a.y);
-    mul(s, A.b, a);
-    W[1][0] = s.x;
-    W[1][1] = s.y;
-    HermitNF(W,W);
-    B.a = W[0][0];
-    B.b.x = W[1][0];
-    B.b.y = W[1][1];
+    ZZ2 s,t;
+    mul(s, a, A.a);
+    mul(t, A.b, a);
+    hnf(B,s,t);
 }
 
 void mul(IDL2& B, const IDL2& A, const ZZ& a) {// B = A*(a)
@@ -125,19 +234,7 @@ void mul(IDL2& B, const IDL2& A, const ZZ& a) {// B = A*(a)
 void sqr(IDL2& B, const IDL2& A) {// B = A*A
     if(IsZero(A)) { clear(B); return; }
     if(IsUnit(A)) { set(B); return; }
-    ZZ2 s;
-    mat_ZZ W;
-    W.SetDims(3,2);
-    sqr(W[0][0], A.a);
-    mul(W[1][0], A.a, A.b.x);
-    mul(W[1][1], A.a, A.b.y);
-    sqr(s, A.b);
-    W[2][0] = s.x;
-    W[2][1] = s.y;
-    HermitNF(W,W);
-    B.a = W[0][0];
-    B.b.x = W[1][0];
-    B.b.y = W[1][1];
+    compose(B,A,A);
 }
 
 long div(const IDL2& A, const IDL2& B) {// test if B divides A
@@ -146,15 +243,30 @@ long div(const IDL2& A, const IDL2& B) {// test if B divides A
     return B==C;
 }
 
-void power(IDL2& B, const IDL2& A, long n) {// B = A^n, assume n>=0
-    if(n==0 || IsUnit(A)) { set(B); return; }
-    if(&B==&A) { power(B, IDL2(A), n); return; }
-    long m(1<<(NumBits(n)-1));
-    B = A;
-    for(m>>=1; m; m>>=1) {
-        sqr(B,B);
-        if(n&m) B *= A;
-    }
+struct RedIDL2 : IDL2 {};
+// ideal reduced after each multiplication.
+// private class, used only internally by power
+
+static void set(RedIDL2& A) { set((IDL2&)A); }
+static void inv(RedIDL2& B, const RedIDL2& A) { conj(B,A); }
+
+static void mul(RedIDL2& C, const RedIDL2& A, const RedIDL2& B)
+{ mul((IDL2&)C, A, B); reduce(C,C); }
+
+static void sqr(RedIDL2& B, const RedIDL2& A)
+{ sqr((IDL2&)B, A); reduce(B,B); }
+
+void power(IDL2& B, const IDL2& A, long n, long red)
+// B = A^n by sliding window method
+// if red==1, B = reduced ideal equivalent to A^n,
+// A^(-1) is replaced by conj(A), and n may be n<0
+{
+    if(IsUnit(A)) { set(B); return; }
+    if(red == 0) { WindowPower(B,A,n); return; }
+    RedIDL2 C,D;
+    reduce(C,A);
+    NAFPower(D,C,n);
+    B = D;
 }
 
 IDL2& operator+=(IDL2& B, const IDL2& A) { add(B,B,A); return B; }// B += A
@@ -193,11 +305,162 @@ void SetPrime(IDL2& A, const ZZ& p)
     else set(A.b, ZZ2::D%8>>2, 1);
 }
 
+#define HGCD_BASE 256// bits below which half gcd is done by sdiv
+#define HGCD_BITS 128// reduce(A) uses half gcd if a > D^2*2^HGCD_BITS
+
+static long sdiv(ZZ M[4], ZZ& a, ZZ& b, long s)
+// one step of euclidean algorithm for a,b >= 2^s.
+// if a > b, a -= q*b where q = floor((a - 2^s)/b),
+// else b -= q*a similarly, so that a,b >= 2^s is kept.
+// (a,b) = M*(a',b') is kept for old (a,b) and new (a',b').
+// if |a-b| < 2^s, return 0 with (a,b) unchanged, else return 1
+// private function, used only internally by hgcd
+{
+    NTL_ZZRegister(q);
+    NTL_ZZRegister(t);
+    if(a > b) {
+        sub(t,a,b);
+        if(NumBits(t) <= s) return 0;
+        a -= power2_ZZ(s);
+        DivRem(q,a,a,b);
+        a += power2_ZZ(s);
+        MulAddTo(M[1], q, M[0]);
+        MulAddTo(M[3], q, M[2]);
+    }
+    else {
+        sub(t,b,a);
+        if(NumBits(t) <= s) return 0;
+        b -= power2_ZZ(s);
+        DivRem(q,b,b,a);
+        b += power2_ZZ(s);
+        MulAddTo(M[0], q, M[1]);
+        MulAddTo(M[2], q, M[3]);
+    }
+    return 1;
+}
+
+static long hgcd_apply(ZZ M[4], ZZ& a, ZZ& b, const ZZ N[4], long s)
+// (a,b) = N^(-1)*(a,b) and M = M*N, if new a,b >= 2^s.
+// else return 0 with (a,b) and M unchanged
+// private function, used only internally by hgcd
+{
+    NTL_ZZRegister(x);
+    NTL_ZZRegister(y);
+    mul(x, N[3], a);
+    MulSubFrom(x, N[1], b);
+    mul(y, N[0], b);
+    MulSubFrom(y, N[2], a);
+    if(NumBits(x) <= s || NumBits(y) <= s ||
+       sign(x) < 0 || sign(y) < 0) return 0;
+    a = x;
+    b = y;
+    mul(x, M[0], N[0]);
+    MulAddTo(x, M[1], N[2]);
+    mul(y, M[0], N[1]);
+    MulAddTo(y, M[1], N[3]);
+    M[0] = x;
+    M[1] = y;
+    mul(x, M[2], N[0]);
+    MulAddTo(x, M[3], N[2]);
+    mul(y, M[2], N[1]);
+    MulAddTo(y, M[3], N[3]);
+    M[2] = x;
+    M[3] = y;
+    return 1;
+}
+
+static void hgcd(ZZ M[4], ZZ& a, ZZ& b)
+// half gcd of a,b > 0, i.e. reduce (a,b) to (a',b') such that
+// a',b' >= 2^s and |a'-b'| < 2^s, s = NumBits(max(a,b))/2 + 1
+// (unless a or b < 2^s on input, when a,b are unchanged).
+// M = [M[0] M[1]; M[2] M[3]], det(M)=1, (a,b) = M*(a',b').
+// the first half of the bits is reduced recursively using
+// only leading bits of a,b, and then the second half,
+// so that time is O(M(n)*log(n)) for n bit inputs,
+// where M(n) is the time of n bit multiplication.
+// results of recursive calls are checked and if they are
+// not valid for whole a,b, they are discarded (which does not
+// occur in theory), and then sdiv steps finish reduction.
+// reference: N. Moller, "On Schonhage's algorithm and
+//   subquadratic integer gcd computation",
+//   Mathematics of Computation 77 (2008) 589-607
+{
+    long n(max(NumBits(a), NumBits(b))), s(n/2+1), p;
+    set(M[0]); clear(M[1]);
+    clear(M[2]); set(M[3]);
+    if(NumBits(a) <= s || NumBits(b) <= s) return;
+    if(n > HGCD_BASE) {
+        ZZ N[4],x,y;
+        p = n/2;
+        RightShift(x,a,p);
+        RightShift(y,b,p);
+        hgcd(N,x,y);
+        hgcd_apply(M,a,b,N,s);
+        n = max(NumBits(a), NumBits(b));
+        while(n > (3*s)/2 + 2 && sdiv(M,a,b,s))
+            n = max(NumBits(a), NumBits(b));
+        p = 2*s - n + 1;
+        if(p > 0 && n - p > 2) {
+            RightShift(x,a,p);
+            RightShift(y,b,p);
+            hgcd(N,x,y);
+            hgcd_apply(M,a,b,N,s);
+        }
+    }
+    while(sdiv(M,a,b,s)) {;}
+}
+
+static void HalfReduce(IDL2& A, infra *i)
+// if A.a is much larger than |D|, replace A by equivalent ideal
+// of norm O(sqrt|D|), by half gcd of (A.a, A.b.x).
+// let r = x*a + y*b for a = A.a, b = A.b.x be a remainder
+// in euclidean algorithm of size about sqrt(a)*|D|^(1/4).
+// then e = r + y*w is in A and |norm(e)| = O(a*sqrt|D|),
+// so that conj(e)*A/a is integral ideal of norm |norm(e)|/a.
+// if i!=0, infra is updated by A = (a*e/norm(e))*(new A).
+// assume A is primitive and A!=0.
+// private function, used only internally by reduce
+// reference: A. Schonhage, "Fast reduction and composition of
+//   binary quadratic forms", ISSAC'91 (1991) 128-133
+{
+    long k,n(NumBits(A.a)), d(NumBits(ZZ2::D));
+    if(n <= 2*d + HGCD_BITS || IsZero(A.b.x)) return;
+    ZZ M[4],a,b,c;
+    ZZ2 e,f,g;
+    k = d/2;// remainders of n/2 + k/2 bits
+    RightShift(a, A.a, k);
+    RightShift(b, A.b.x, k);
+    hgcd(M,a,b);
+    // e = M[3]*a - M[1]*(b+w), f = -M[2]*a + M[0]*(b+w)
+    mul(e.x, M[3], A.a);
+    MulSubFrom(e.x, M[1], A.b.x);
+    negate(e.y, M[1]);
+    mul(f.x, M[0], A.b.x);
+    MulSubFrom(f.x, M[2], A.a);
+    f.y = M[0];
+    norm(a,e);
+    norm(b,f);
+    if(abs(b) < abs(a)) { e = f; a = b; }
+    if(IsZero(a)) return;
+    conj(f,e);
+    mul(g, A.b, f);
+    if(!div(g, g, A.a)) return;// A is not invertible
+    hnf(A,f,g);
+    c = content(A);
+    if(!IsOne(c)) primitive(A,A);
+    if(i==0) return;
+    // a*e/norm(e) = c*e/(c^2*A.a) by norm(e) = a*norm(new A)
+    if(sign(a) < 0) negate(e,e);
+    i->n *= e;
+    mul(b, c, A.a);
+    i->d *= b;
+}
+
 void normalize(IDL2& B, const IDL2& A)
 // assume A is primitive and A!=0.
 // private function, used only internally by cfrac
 {
-    ZZ n;
+    NTL_ZZRegister(n);
     if(sign(ZZ2::D) < 0 || A.a > IDL2::S) {
         LeftShift(n, A.b.x, 1);
         if(ZZ2::Dm4) n++;
@@ -229,7 +492,7 @@ long cfrac(IDL2& A, long red)
 // continued fractio expansion.
 // assume A is primitive and A!=0
 {
-    IDL2 B;
+    NTL_TLS_LOCAL(IDL2, B);// workspace reused in each step
     normalize(B,A);
     if(red && IsReduced(A.a, B.b.x, B.a))
         return 1;
@@ -242,7 +505,7 @@ long cfrac(infra& i, IDL2& A, long red)
 // continued fractio expansion.
 // assume A is primitive and A!=0
 {
-    IDL2 B;
+    NTL_TLS_LOCAL(IDL2, B);// workspace reused in each step
     normalize(B,A);
     if(red && IsReduced(A.a, B.b.x, B.a))
         return 1;
@@ -257,24 +520,67 @@ void reduce(IDL2& B, const IDL2& A)
 // assume A!=0
 {
     primitive(B,A);
+    HalfReduce(B,0);
     while(cfrac(B,1) == 0) {;}
 }
 
-long IsEquiv(const IDL2& A, const IDL2& B)
+void reduce(infra& i, IDL2& A)
+// A = reduction of A, i *= infra of reduction
+// assume A is primitive and A!=0
+{
+    HalfReduce(A,&i);
+    while(cfrac(i,A,1) == 0) {;}
+}
+
+static long find(double& y, double& R, const IDL2& B,
+                 const PrincipalCycle* P)
+// find reduced ideal B in principal cycle by index P
+// (see PrincipalCycle::find), R = regulator.
+// if P==0, index for current D is taken from CycleCache
+// or made here and cached.
+{
+    if(P==0) P = IDL2::CycleCache.find(ZZ2::D);
+    if(P==0) {
+        PrincipalCycle Q;
+        IDL2::CycleCache.insert(ZZ2::D, Q);
+        return find(y,R,B,&Q);
+    }
+    if(P->D != ZZ2::D)
+        throw std::runtime_error("PrincipalCycle of other D");
+    R = P->R;
+    return P->find(y,B);
+}
+
+static long IsPrincipal(const IDL2& A, const PrincipalCycle* P);
+static long IsPrincipal(compact& a, const IDL2& A, const PrincipalCycle* P);
+
+static long IsEquiv(const IDL2& A, const IDL2& B, const PrincipalCycle* P)
 // test if A and B are equivalent
 {
     if(IsZero(A) || IsZero(B)) return 1;
-    IDL2 C,D;
+    NTL_TLS_LOCAL(IDL2, C);
+    NTL_TLS_LOCAL(IDL2, D);
+    NTL_TLS_LOCAL(IDL2, E);
     reduce(C,A);
     reduce(D,B);
     if(C==D) return 1;
     if(sign(ZZ2::D) < 0) return 0;
-    IDL2 E(C);
-    for(cfrac(C); C!=D; cfrac(C))
-        if(C==E) return 0;
+    // C*conj(D) = (N(D))*C/D if D is invertible
+    if(IsInvertible(D)) { conj(E,D); E *= C; return IsPrincipal(E,P); }
+    if(IsInvertible(C)) { conj(E,C); E *= D; return IsPrincipal(E,P); }
+    // D and C are not invertible (D is not fundamental)
+    CycleWalker W(C), Y(D), Z(C);
+    for(W.step(); W.a!=Y.a || W.u!=Y.u; W.step())
+        if(W.a==Z.a && W.u==Z.u) return 0;
     return 1;
 }
 
+long IsEquiv(const IDL2& A, const IDL2& B)
+{ return IsEquiv(A,B,0); }// test if A and B are equivalent
+
+long IsEquiv(const IDL2& A, const IDL2& B, const PrincipalCycle& P)
+{ return IsEquiv(A,B,&P); }// test if A and B are equivalent
+
 long IsEquiv(ZZ2& a, const IDL2& A, const IDL2& B)
 // test if A and B are equivalent
 // and output a such that A = (a)*B/norm(B)
@@ -285,51 +591,513 @@ long IsEquiv(ZZ2& a, const IDL2& A, const IDL2& B)
     return IsPrincipal(a,C);
 }
 
-long IsPrincipal(const IDL2& A)
+static long IsPrincipal(const IDL2& A, const PrincipalCycle* P)
 // test if A is principal ideal
 {
     if(IsZero(A)) return 1;
-    IDL2 B;
+    NTL_TLS_LOCAL(IDL2, B);
     reduce(B,A);
     if(IsUnit(B)) return 1;
     if(sign(ZZ2::D) < 0) return 0;
-    IDL2 C(B);
-    for(cfrac(B); !IsUnit(B); cfrac(B))
-        if(B==C) return 0;
-    return 1;
+    double y,R;
+    return find(y,R,B,P);
 }
 
-long IsPrincipal(ZZ2& a, const IDL2& A)
+static long IsPrincipal(ZZ2& a, const IDL2& A, const PrincipalCycle* P)
 // test if A = (a) for some a
 {
-    if(IsZero(A)) { clear(a); return 1; }
-    IDL2 B;
-    infra i;
-    primitive(B,A);
-    while(cfrac(i,B,1) == 0) {;}
-    if(!IsUnit(B)) {
-        if(sign(ZZ2::D) < 0) return 0;
-        IDL2 C(B);
-        for(cfrac(i,B); !IsUnit(B); cfrac(i,B))
-            if(B==C) return 0;
-    }
-    i.eval(a);
-    a *= content(A);
+    compact c;
+    if(!IsPrincipal(c,A,P)) return 0;
+    expand(a,c);
     if(sign(a.y) < 0) negate(a,a);// upper half
     return 1;
 }
 
+long IsPrincipal(const IDL2& A)
+{ return IsPrincipal(A,0); }// test if A is principal ideal
+
+long IsPrincipal(const IDL2& A, const PrincipalCycle& P)
+{ return IsPrincipal(A,&P); }// test if A is principal ideal
+
+long IsPrincipal(ZZ2& a, const IDL2& A)
+{ return IsPrincipal(a,A,0); }// test if A = (a) for some a
+
+long IsPrincipal(ZZ2& a, const IDL2& A, const PrincipalCycle& P)
+{ return IsPrincipal(a,A,&P); }// test if A = (a) for some a
+
 long IDL2::FundUnit(ZZ2& u)
 // u = fundamental unit, return norm(u)
 {
     if(ZZ2::D < -4) { set(u); return 1; }
     if(sign(ZZ2::D) < 0) { set(u,0,1); return 1; }
-    long s(1);
+    Pair<ZZ2, long> *p(UnitCache.find(ZZ2::D));
+    if(p) { u = p->a; return p->b; }
+    compact c;
+    long s(FundUnit(c));
+    expand(u,c);
+    UnitCache.insert(ZZ2::D, Pair<ZZ2, long>(u,s));
+    return s;
+}
+
+void CycleWalker::set(const IDL2& A)
+// u = 2*b + (D mod 4) for b normalized as in cfrac
+{
+    add(S1, IDL2::W1, IDL2::W1);
+    S1 += ZZ2::Dm4;
+    double r(to_double(ZZ2::D - sqr(IDL2::S))), s(to_double(IDL2::S));
+    f = r/(2*s);
+    f = r/(2*s + f);// sqrt(D) - S = (D - S^2)/(sqrt(D) + S)
+    a = A.a;
+    sub(u, IDL2::W1, A.b.x);
+    sub(u, IDL2::W1, u%=a);
+    u <<= 1;
+    u += ZZ2::Dm4;
+    sqr(c,u);
+    sub(c, ZZ2::D, c);
+    c /= a;
+    c >>= 2;
+}
+
+void CycleWalker::get(IDL2& A) const
+// A = aZ + (b+w)Z, 0 <= b < a
+{
+    A.a = a;
+    sub(A.b.x, u, ZZ2::Dm4);
+    A.b.x >>= 1;
+    A.b.x %= a;
+    NTL::set(A.b.y);
+}
+
+double CycleWalker::dist() const
+// log((u + sqrt(D))/2) - log(c)
+{
+    NTL_ZZRegister(t);
+    add(t, u, IDL2::S);
+    return log(t) + log1p(f/to_double(t)) - log(2.) - log(c);
+}
+
+void CycleWalker::step()
+// (a,c,u) = (c, a + q*u - q^2*c, 2*q*c - u)
+{
+    NTL_ZZRegister(q);
+    NTL_ZZRegister(t);
+    NTL_TLS_LOCAL(ZZ, v);// swapped with c
+    add(t, u, S1);
+    LeftShift(v, c, 1);
+    div(q, t, v);
+    mul(t, q, c);
+    sub(v, u, t);// u - q*c
+    sub(u, t, v);// 2*q*c - u
+    mul(v, v, q);
+    v += a;// a + q*u - q^2*c
+    swap(a,c);
+    swap(c,v);
+}
+
+void CycleWalker::step(infra& i)
+// i *= (b+w)/c before step
+{
+    NTL_TLS_LOCAL(ZZ2, b);
+    sub(b.x, u, ZZ2::Dm4);
+    b.x >>= 1;
+    NTL::set(b.y);
+    i.n *= b;
+    i.d *= c;
+    step();
+}
+
+double CycleWalker::walk(infra& i, double t)
+// Lehmer's method: let k be such that a,c,u,S1 < 2^(k+48),
+// and (A,C,U,S) = (a,c,u,S1)/2^k truncated to integers.
+// steps are applied to (A,C,U) with error bounds (ea,ec,eu),
+// as long as q is determined uniquely by interval arithmetic,
+// q < 64 and matrix M of steps has entries < 2^40.
+// also distances of steps are computed from (A,C,U).
+// then (a,c,u) = M*(a,c,u), and if e[0] = a, e[1] = b+w and
+// e[j+2] = q[j]*e[j+1] + e[j] for j-th partial quotient q[j],
+// then infra of m steps is given by i.n *= e[m],
+// i.d *= |norm(e[m])|/a for a before m steps.
+// if no step is determined, one step is done by step(i).
+{
+    long j,k,m,q,x0,y0,x1,y1,x2,y2,M[3][3],N[3];
+    long A,C,U,S,ea,ec,eu,es,fa,fc,fu;
+    double e(0),h,r;
+    NTL_TLS_LOCAL(ZZ2, b);
+    NTL_TLS_LOCAL(ZZ, v);
+    NTL_TLS_LOCAL(ZZ, a1);// swapped with a,c,u
+    NTL_TLS_LOCAL(ZZ, c1);
+    NTL_TLS_LOCAL(ZZ, u1);
+    for(;;) {
+        k = max(max(NumBits(a), NumBits(c)), max(NumBits(u), NumBits(S1)));
+        k = max(k-48, 0L);
+        A = conv<long>(a>>k);
+        C = conv<long>(c>>k);
+        U = conv<long>(u>>k);
+        S = conv<long>(S1>>k);
+        r = ldexp(to_double(IDL2::S) + f, -k);
+        ea = ec = eu = es = (k ? 1 : 0);
+        for(j=0; j<3; j++) for(m=0; m<3; m++) M[j][m] = (j==m);
+        x0 = y1 = 1; x1 = y0 = 0;
+        for(m=0;; m++) {
+            if(C - ec <= 0 || U + S - eu - es < 0) break;
+            q = (U + S - eu - es)/(2*(C + ec));
+            if(q != (U + S + eu + es)/(2*(C - ec)) || q >= 64) break;
+            fa = ec;
+            fc = ea + q*eu + q*q*ec;
+            fu = 2*q*ec + eu;
+            if(fc > (1L<<20)) break;
+            for(j=0; j<3; j++) {
+                N[j] = M[0][j] + q*M[2][j] - q*q*M[1][j];
+                if(N[j] >= (1L<<40) || N[j] <= -(1L<<40)) break;
+            }
+            if(j<3) break;
+            x2 = q*x1 + x0;
+            y2 = q*y1 + y0;
+            if(x2 >= (1L<<40) || y2 >= (1L<<40)) break;
+            h = log(U + r) - log(2.) - log(double(C));
+            if(e + h > t) break;
+            e += h;
+            for(j=0; j<3; j++) {
+                M[0][j] = M[1][j];
+                M[2][j] = 2*q*M[1][j] - M[2][j];
+                M[1][j] = N[j];
+            }
+            N[0] = C;
+            C = A + q*U - q*q*C;
+            U = 2*q*N[0] - U;
+            A = N[0];
+            ea = fa; ec = fc; eu = fu;
+            x0 = x1; x1 = x2;
+            y0 = y1; y1 = y2;
+        }
+        if(m == 0) {
+            h = dist();
+            if(e + h > t) return e;
+            step(i);
+            e += h;
+            continue;
+        }
+        // infra by e[m] = x0*a + y0*(b+w)
+        sub(b.x, u, ZZ2::Dm4);
+        b.x >>= 1;
+        mul(b.x, b.x, y0);
+        MulAddTo(b.x, a, x0);
+        conv(b.y, y0);
+        norm(v, b);
+        abs(v, v);
+        v /= a;
+        i.n *= b;
+        i.d *= v;
+        // (a,c,u) = M*(a,c,u)
+        mul(a1, a, M[0][0]); MulAddTo(a1, c, M[0][1]); MulAddTo(a1, u, M[0][2]);
+        mul(c1, a, M[1][0]); MulAddTo(c1, c, M[1][1]); MulAddTo(c1, u, M[1][2]);
+        mul(u1, a, M[2][0]); MulAddTo(u1, c, M[2][1]); MulAddTo(u1, u, M[2][2]);
+        swap(a,a1);
+        swap(c,c1);
+        swap(u,u1);
+    }
+}
+
+static void RemoveContent(ZZ2& n, ZZ& d)
+// divide n and d by gcd(n.x, n.y, d)
+{
+    NTL_ZZRegister(g);
+    GCD(g, n.x, n.y);
+    GCD(g, g, d);
+    if(IsOne(g)) return;
+    n.x /= g;
+    n.y /= g;
+    d /= g;
+}
+
+static void append(compact& c, const infra& i)
+// append i.n/i.d to c as last factor
+{
+    c.n.append(i.n);
+    c.d.append(i.d);
+    RemoveContent(c.n[c.n.length()-1], c.d[c.d.length()-1]);
+}
+
+static void ForwardTo(compact& c, const IDL2& X, double t)
+// c = number in compact representation such that X = (1/c),
+// where X is reduced and principal, and is reached from (1)
+// by cfrac with distance t (approximately), i.e., log(c) = t.
+// let t[j] = t/2**(k-j) and e = log(D).
+// P[0] is reached from (1) by cfrac with distance <= t[0]-e,
+// and P[j+1] is reduction of P[j]**2 moved forward by cfrac
+// with distance <= t[j+1]-e, so that P[k] is behind X by O(e).
+// if P[j] = (1/c[j]), then c[j+1] = c[j]**2 * (n/d) where
+// n/d is given by infra of reduction and content of P[j]**2.
+// assume D>0, t < regulator, and if t <= 4*e, X!=(1)
+// reference: J. Buchmann, C. Thiel and H. C. Williams
+//   "Short representation of quadratic integers" (1995)
+{
+    long j,k;
+    double e(0), g(log(ZZ2::D));
+    IDL2 P(1);
+    infra i;
+    CycleWalker W, Y(X);
+    c.n.SetLength(0);
+    c.d.SetLength(0);
+    for(k=0; ldexp(t,-k) > 4*g; k++);
+    for(j=0; j<=k; j++) {
+        if(j) {
+            sqr(P,P);
+            i.n = content(P);
+            set(i.d);
+            primitive(P,P);
+            reduce(i,P);
+            e = 2*e + log(i.n) - log(i.d);
+        }
+        W.set(P);
+        if(j==k) { while(W.a!=Y.a || W.u!=Y.u) W.step(i); }
+        else e += W.walk(i, ldexp(t,j-k) - g - e);
+        W.get(P);
+        append(c,i);
+    }
+}
+
+PrincipalCycle::PrincipalCycle(long m)
+// baby steps: (1) = B[0], B[1], ..., B[m] by cfrac, stored in
+//   hash table with distances. if (1) appears, R is found.
+// giant steps: H[i+1] = reduction of H[i]*G, where G = B[k],
+//   k ~ D^(1/4), and baby steps are continued until
+//   dist(B[m]) >= dist(G) + 2*log(D) so that no distance
+//   is skipped by giant steps.
+//   if H[i] = B[j] for H[0] = G, then R = dist(H[i]) - dist(B[j]).
+// distances are tracked in double precision; for composition,
+//   dist(H*G) = dist(H) + dist(G) + log(content(H*G)) + log(i)
+//   where i is infra of reduction of primitive part of H*G.
+    : D(ZZ2::D), x(0), w(0), R(0)
+{
+    long j;
+    double e(0), g;
+    ZZ s;
     IDL2 A(1);
+    CycleWalker W;
+    std::unordered_map<IDL2, double, IDL2Hash>::iterator p;
+    T[A] = 0;
+    if(sign(D) < 0) return;
+    W.set(A);
+    g = log(D);
+    SqrRoot(s, ZZ2::D);
+    SqrRoot(s, s);
+    if(m <= 0) m = (NumBits(s) < 22 ? conv<long>(s) : 1L<<22);
+    for(j=0; j<m || e < x + 2*g; j++) {
+        e += W.dist();
+        W.step();
+        if(W.IsUnit()) { R = w = e; return; }
+        W.get(A);
+        T[A] = w = e;
+        if(j == m-1) { G = A; x = e; }
+    }
+    for(A = G, e = x;;) {
+        giant(A,e);
+        p = T.find(A);
+        if(p != T.end() && e - p->second > x) {
+            R = e - p->second;
+            return;
+        }
+    }
+}
+
+void PrincipalCycle::giant(IDL2& H, double& e) const
+// H = reduction of H*G, e += distance from H to H*G
+{
     infra i;
-    do { cfrac(i,A); s=-s; } while(!IsUnit(A));
-    i.eval(u);
-    return s;
+    mul(H,H,G);
+    i.n = content(H);
+    set(i.d);
+    primitive(H,H);
+    reduce(i,H);
+    e += x + log(i.n) - log(i.d);
+}
+
+long PrincipalCycle::find(double& y, const IDL2& B) const
+// test if reduced ideal B is in principal cycle,
+// and if so, y = distance from (1) to B (0 <= y < R).
+// giant steps H[i] from B are looked up in baby steps,
+// and if H[i] = B[j], then y = dist(B[j]) - dist(H[i]) mod R.
+// if baby steps cover whole cycle, one look up is enough,
+// else giant steps are made until dist(H[i]) - dist(B) > R
+{
+    double e(0);
+    NTL_TLS_LOCAL(IDL2, H);
+    std::unordered_map<IDL2, double, IDL2Hash>::const_iterator p;
+    for(H = B;; giant(H,e)) {
+        p = T.find(H);
+        if(p != T.end()) {
+            for(y = p->second - e; y < 0; y += R) {;}
+            return 1;
+        }
+        if(w >= R || e > R) return 0;
+    }
+}
+
+double IDL2::Regulator()
+// regulator by baby-step giant-step (see PrincipalCycle).
+// assume D>0.
+{
+    PrincipalCycle *P(CycleCache.find(ZZ2::D));
+    if(P) return P->R;
+    PrincipalCycle Q;
+    CycleCache.insert(ZZ2::D, Q);
+    return Q.R;
+}
+
+long IDL2::FundUnit(compact& u)
+// u = fundamental unit in compact representation, return norm(u).
+// regulator R is computed by baby-step giant-step, and
+// if R <= 4*log(D), u has only one factor.
+{
+    if(sign(ZZ2::D) < 0) {
+        ZZ2 v;
+        long s(FundUnit(v));
+        u.n.SetLength(1);
+        u.d.SetLength(1);
+        u.n[0] = v;
+        set(u.d[0]);
+        return s;
+    }
+    long k;
+    double R(Regulator());
+    ZZ s;
+    IDL2 A(1);
+    infra i;
+    if(R > 4*log(ZZ2::D)) ForwardTo(u,A,R);
+    else {
+        CycleWalker W(A);
+        do W.step(i); while(!W.IsUnit());
+        u.n.SetLength(0);
+        u.d.SetLength(0);
+        append(u,i);
+    }
+    k = u.n.length()-1;
+    if(sign(u) < 0) negate(u.n[k], u.n[k]);
+    norm(s, u.n[k]);// other factors have even exponents
+    return sign(s);
+}
+
+static long IsPrincipal(compact& a, const IDL2& A, const PrincipalCycle* P)
+// test if A = (a) for some a in compact representation.
+// let B be reduced ideal of primitive part of A,
+// and B is reached to (1) by cfrac with distance t
+// (t is found by baby-step giant-step in PrincipalCycle P).
+// if t is large, conj(B) is reached from (1) with
+// distance t - log(norm(B)), and conj(B) = (1/c) implies
+// B = (norm(B)*c) by B*conj(B) = (norm(B))
+{
+    long k;
+    double t(0);
+    compact c;
+    NTL_TLS_LOCAL(IDL2, B);
+    NTL_TLS_LOCAL(IDL2, C);
+    infra i;
+    primitive(B,A);
+    if(IsZero(A)) set(B);
+    else reduce(i,B);
+    if(!IsUnit(B)) {
+        if(sign(ZZ2::D) < 0) return 0;
+        double R;
+        if(!find(t,R,B,P)) return 0;
+        t = R - t;
+        if(t > 4*log(ZZ2::D)) {
+            conj(C,B);
+            ForwardTo(c, C, t - log(B.a));
+            i.n *= B.a;
+        }
+        else {
+            CycleWalker W(B);
+            do W.step(i); while(!W.IsUnit());
+        }
+    }
+    i.n *= content(A);
+    if(c.n.length() == 0) append(c,i);
+    else {
+        k = c.n.length()-1;
+        c.n[k] *= i.n;
+        c.d[k] *= i.d;
+        RemoveContent(c.n[k], c.d[k]);
+    }
+    a = c;
+    return 1;
+}
+
+long IsPrincipal(compact& a, const IDL2& A)
+{ return IsPrincipal(a,A,0); }// test if A = (a) in compact representation
+
+long IsPrincipal(compact& a, const IDL2& A, const PrincipalCycle& P)
+{ return IsPrincipal(a,A,&P); }// test if A = (a) in compact representation
+
+long expand(ZZ2& a, const compact& c)
+// a = value of c.
+// if c is not integral, return 0
+{
+    long j;
+    ZZ2 n(c.n[0]);
+    ZZ d(c.d[0]);
+    for(j=1; j<c.n.length(); j++) {
+        sqr(n,n);
+        n *= c.n[j];
+        sqr(d,d);
+        d *= c.d[j];
+    }
+    return div(a,n,d);
+}
+
+long eval(ZZ2& a, const compact& c, const ZZ& m)
+// a = value of c modulo m
+{
+    long j;
+    ZZ s;
+    ZZ2 b(1);
+    for(j=0; j<c.n.length(); j++) {
+        if(InvModStatus(s, c.d[j]%m, m)) return 0;
+        sqr(b,b);
+        b *= c.n[j];
+        b *= s;
+        rem(b.x, b.x, m);
+        rem(b.y, b.y, m);
+    }
+    a = b;
+    return 1;
+}
+
+void norm(ZZ& n, const compact& c)
+// n = norm of c.
+// estimate |n| by logarithms, and compute n modulo
+// product of small primes which exceeds 4|n|
+{
+    long j,k(c.n.length()),p;
+    double e(0);
+    ZZ m(1),s;
+    ZZ2 a;
+    PrimeSeq ps;
+    for(j=0; j<k; j++) {
+        norm(s, c.n[j]);
+        e = 2*e + log(abs(s)) - 2*log(c.d[j]);
+    }
+    e = e/log(2.) + 3;// log2(4|n|) + 1
+    while(NumBits(m) < e) {
+        p = ps.next();
+        for(j=0; j<k; j++) if(divide(c.d[j], p)) break;
+        if(j==k) m *= p;
+    }
+    eval(a,c,m);
+    norm(s,a);
+    rem(n,s,m);
+    if(n > (m>>1)) n -= m;
+}
+
+long sign(const compact& c)// sign of c as real number
+{ return sign(c.n[c.n.length()-1]); }
+
+double log(const compact& c) {// log|c|
+    long j;
+    double e(0);
+    for(j=0; j<c.n.length(); j++)
+        e = 2*e + log(c.n[j]) - log(c.d[j]);
+    return e;
 }
 
 long IDL2::FundUnit(ZZ2& u, const ZZ& D)
@@ -341,7 +1109,28 @@ long IDL2::FundUnit(ZZ2& u, const ZZ& D)
     return IDL2::FundUnit(u);
 }
 
+long IDL2::FundUnit(ZZ2& u, const IDL2Context& c)
+// set discriminant context c and output u = fundamental unit.
+// old value of D is restored on exit
+{
+    IDL2Push p(c);
+    return IDL2::FundUnit(u);
+}
+
+size_t IDL2Hash::operator()(const IDL2& A) const
+// hash value of A from low bits of A.a and A.b.x
+{
+    size_t h(trunc_long(A.a, NTL_BITS_PER_LONG));
+    h = h*1000003 ^ trunc_long(A.b.x, NTL_BITS_PER_LONG);
+    return h*1000003 ^ trunc_long(A.b.y, NTL_BITS_PER_LONG);
+}
+
 std::ostream& operator<<(std::ostream& s, const IDL2& A) {
     s << '[' << A.a << ' ' << A.b << ']';
     return s;
+}
+
+std::ostream& operator<<(std::ostream& s, const compact& c) {
+    s << '[' << c.n << ' ' << c.d << ']';
+    return s;
 }
\ No newline at end of file
@@ -5,6 +5,14 @@
 #define __IDL2_h__
 
 #include "ZZ2.h"
+#include "LRUCache.h"
+#include<NTL/vector.h>
+#include<NTL/pair.h>
+#include<unordered_map>
+
+struct IDL2Context;
+struct compact;
+struct PrincipalCycle;
 
 struct IDL2
 // integral ideal in quadratic field aZ + bZ
@@ -15,9 +23,14 @@ struct IDL2
     NTL::ZZ a;// integral basis a, a>0
     ZZ2 b; // integral basis b, 0<=b.x<a, b.y>0
     // b.y divides both a and b.x; a divides norm(b)
-    static NTL::ZZ S;// floor(sqrt(D)) (used only for D>0)
-    static NTL::ZZ W;// floor(w) (used only for D>0)
-    static NTL::ZZ W1;// floor(-conj(w)) (used only for D>0)
+    static thread_local NTL::ZZ S;// floor(sqrt(D)) (used only for D>0)
+    static thread_local NTL::ZZ W;// floor(w) (used only for D>0)
+    static thread_local NTL::ZZ W1;// floor(-conj(w)) (used only for D>0)
+    static thread_local LRUCache<NTL::Pair<ZZ2, long> > UnitCache;
+    // cache of (u, norm(u)) computed by FundUnit(ZZ2&) for D>0
+    static thread_local LRUCache<PrincipalCycle> CycleCache;
+    // cache of index of principal cycle for D>0 made by
+    // IsPrincipal, IsEquiv and Regulator without PrincipalCycle
     static void init(const NTL::ZZ& D);// set discriminant D
     // if D!=0,1 (mod 4) D is square, raise runtime_error
     static void init(long D) { init(NTL::ZZ(D)); }
@@ -27,17 +40,37 @@ struct IDL2
     static long FundUnit(ZZ2& u, const NTL::ZZ& D);
     // u = fundamenatal unit for new discriminant D
     // old value of D is restored on exit
+    static long FundUnit(ZZ2& u, const IDL2Context& c);
+    // u = fundamenatal unit for discriminant context c
+    static long FundUnit(compact& u);
+    // u = fundamenatal unit in compact representation
+    static double Regulator();
+    // regulator log(u) of fundamental unit u>1 for D>0
+    // by baby-step giant-step in infrastructure
     IDL2() {;}
     IDL2(const ZZ2& a);// principal ideal (a)
     IDL2(const NTL::ZZ& a);// principal ideal (a)
     IDL2(long a);// principal ideal (a)
 };
 
-struct IDL2Push : ZZ2Push {
+struct IDL2Context : ZZ2Context
+// discriminant context D,D4,Dm4,S,W,W1 of IDL2
+{
     NTL::ZZ S,W,W1;
-    IDL2Push() : S(IDL2::S), W(IDL2::W), W1(IDL2::W1) {;}
+    IDL2Context() : S(IDL2::S), W(IDL2::W), W1(IDL2::W1) {;}
     // save current values of D,D4,Dm4,S,W,W1
-    ~IDL2Push() { IDL2::S=S; IDL2::W=W; IDL2::W1=W1; }
+    explicit IDL2Context(const NTL::ZZ& D);
+    // context for discriminant D (current values are unchanged)
+    void restore() const
+    { ZZ2Context::restore(); IDL2::S=S; IDL2::W=W; IDL2::W1=W1; }
+    // set D,D4,Dm4,S,W,W1 of current thread to saved values
+};
+
+struct IDL2Push : IDL2Context {
+    IDL2Push() {;}// save current values of D,D4,Dm4,S,W,W1
+    IDL2Push(const IDL2Context& c) { c.restore(); }
+    // save current values and set context c
+    ~IDL2Push() { restore(); }
     // restore old values when this object is destructed
 };
 
@@ -54,6 +87,63 @@ struct infra
     void eval(ZZ2& a) { div(a,n,d); }// a = exp(distance)
 };
 
+struct compact
+// compact representation of quadratic number for D>0
+// a = product of (n[j]/d[j])**(2**(k-j)) for j=0,...,k
+// where k = n.length()-1, d[j]>0.
+// n[j] and d[j] have O(log D) bits, so that size of compact
+// grows only as log(log|a|) instead of log|a|
+// reference: J. Buchmann, C. Thiel and H. C. Williams
+//   "Short representation of quadratic integers" (1995)
+{
+    NTL::Vec<ZZ2> n;// numerators
+    NTL::Vec<NTL::ZZ> d;// denominators
+};
+
+struct CycleWalker
+// cycle of reduced ideals for D>0 walked by cfrac.
+// current ideal A = aZ + (b+w)Z is kept as (a,c,u) where
+// u = 2*b + (D mod 4) for normalized b (as in cfrac)
+// and c = (D - u^2)/(4a) = norm of next ideal, so that
+// one step of cfrac is a linear map of (a,c,u):
+//   q = floor((u + S1)/(2c)), S1 = 2*floor(-conj(w)) + (D mod 4),
+//   (a,c,u) = (c, a + q*u - q^2*c, 2*q*c - u)
+// without division, norm and conj of multiprecision numbers.
+// walk() computes several partial quotients q from leading bits
+// of (a,c,u) in single precision, and applies them at once
+// as a 3x3 matrix (Lehmer's method), and infra is updated
+// by one multiplication for those steps.
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    section 5.7 and 1.3.2 (Lehmer's method)
+{
+    NTL::ZZ a,c,u;// current state
+    NTL::ZZ S1;// 2*IDL2::W1 + (D mod 4)
+    double f;// sqrt(D) - IDL2::S
+    CycleWalker() {;}
+    CycleWalker(const IDL2& A) { set(A); }
+    void set(const IDL2& A);
+    // start from A, assume A is primitive, reduced and D>0
+    void get(IDL2& A) const;// A = current ideal
+    long IsUnit() const { return NTL::IsOne(a); }// test if A==(1)
+    double dist() const;// distance from A to next ideal
+    void step();// A = cfrac(A)
+    void step(infra& i);// same as cfrac(i,A)
+    double walk(infra& i, double t);
+    // cfrac(i,A) is repeated while distance walked is <= t
+    // return distance walked
+};
+
+long expand(ZZ2& a, const compact& c);
+// a = value of c; if c is not integral, return 0 with a unchanged
+long eval(ZZ2& a, const compact& c, const NTL::ZZ& m);
+// a = value of c modulo m, 0 <= a.x, a.y < m
+// if some d[j] is not invertible modulo m, return 0
+void norm(NTL::ZZ& n, const compact& c);
+// n = norm of c, assume c is integral
+long sign(const compact& c);// sign of c as real number
+double log(const compact& c);// log|c|
+
 void clear(IDL2& A);// A = zero ideal
 void set(IDL2& A);// A = unit ideal
 void conv(IDL2& A, const ZZ2& a);// principal ideal (a)
@@ -85,7 +175,9 @@ inline void mul(IDL2& B, const NTL::ZZ& a, const IDL2& A) { mul(B,A,a); }
 inline void mul(IDL2& B, const ZZ2& a, const IDL2& A) { mul(B,A,a); }
 
 long div(const IDL2& A, const IDL2& B);// test if B divides A
-void power(IDL2& B, const IDL2& A, long n);// B = A**n (n>=0)
+void power(IDL2& B, const IDL2& A, long n, long red=0);
+// B = A**n (n>=0)
+// if red==1, B = reduced ideal equivalent to A**n (n may be n<0)
 
 IDL2& operator+=(IDL2& A, const IDL2& B);// A = A+B
 IDL2& operator+=(IDL2& A, const ZZ2& b);// A = A+(b)
@@ -94,6 +186,10 @@ IDL2& operator*=(IDL2& A, const IDL2& B);// A = A*B
 IDL2& operator*=(IDL2& A, const NTL::ZZ& b);// A = A*(b)
 IDL2& operator*=(IDL2& A, const ZZ2& b);// A = A*(b)
 
+struct IDL2Hash
+// hash function of ideals, e.g., for std::unordered_map
+{ size_t operator()(const IDL2& A) const; };
+
 // test equality, assuming 0<=b.x<a
 inline long operator==(const IDL2& A, const IDL2& B)
 { return A.a == B.a && A.b == B.b; }
@@ -137,6 +233,14 @@ long cfrac(infra& i, IDL2& A, long red=0);
 void reduce(IDL2&B, const IDL2& A);
 // B = reduced ideal of A
 
+void reduce(infra& i, IDL2& A);
+// A = reduced ideal of primitive A, i *= infra of reduction
+// if A.a is much larger than D, A is first reduced to norm
+// O(sqrt|D|) by half gcd in quasi-linear time, and then by cfrac
+
+long IsInvertible(const IDL2& A);
+// test if A*conj(A) = (norm(A)) (always true if D is fundamental)
+
 long IsEquiv(const IDL2& A, const IDL2& B);
 // test if A and B are equivalent ideals
 
@@ -151,6 +255,46 @@ long IsPrincipal(ZZ2& a, const IDL2& A);
 // if A is principal, output a such that A = (a)
 // else a is unchanged
 
+long IsPrincipal(compact& a, const IDL2& A);
+// if A is principal, output a in compact representation
+// such that A = (a); else a is unchanged
+
+struct PrincipalCycle
+// index of principal cycle for D>0, made by baby steps
+// (1) = B[0], B[1], ..., B[m] of cfrac and stored in hash table
+// with their distances, together with giant step G and regulator R.
+// once made for discriminant D, principal ideal tests for D need
+// only reduction and about R/x giant steps with hash look ups,
+// or only one look up if baby steps cover whole principal cycle.
+// if D<0, table has only (1).
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    section 5.8
+{
+    NTL::ZZ D;// discriminant for which index is made
+    std::unordered_map<IDL2, double, IDL2Hash> T;// baby steps
+    IDL2 G;// giant step
+    double x;// distance of G
+    double w;// distance of last baby step
+    double R;// regulator
+    PrincipalCycle(long m=0);
+    // make index for current discriminant with m baby steps
+    // (if m<=0, m ~ D^(1/4)); more baby steps make tests faster
+    void giant(IDL2& H, double& e) const;
+    // H = reduction of H*G, e += distance from H to H*G
+    long find(double& y, const IDL2& B) const;
+    // if reduced ideal B is in principal cycle, return 1
+    // and y = distance from (1) to B (0 <= y < R), else return 0
+};
+
+long IsEquiv(const IDL2& A, const IDL2& B, const PrincipalCycle& P);
+long IsPrincipal(const IDL2& A, const PrincipalCycle& P);
+long IsPrincipal(ZZ2& a, const IDL2& A, const PrincipalCycle& P);
+long IsPrincipal(compact& a, const IDL2& A, const PrincipalCycle& P);
+// same as above, using index P of principal cycle
+// so that repeated tests for same D are fast
+
 std::ostream& operator<<(std::ostream&, const IDL2&);// for printing
+std::ostream& operator<<(std::ostream&, const compact&);// for printing
 
 #endif // __IDL2_h__
\ No newline at end of file
@@ -2,15 +2,37 @@
 //   http://www.shoup.net/ntl
 
 #include "IDL2ClassGroup.h"
+#include "IDL2L.h"
 #include "GroupGenerator.h"
+#include "WindowPower.h"
 #include "ZZFactoring.h"
 #include<exception>
-#include<list>
+#include<unordered_map>
 using namespace NTL;
 
-ZZ ICG2::amax;// Minkowski bound for a
+thread_local ZZ ICG2::amax;// Minkowski bound for a
+thread_local ZZ ICG2::L;// floor(|D/4|**(1/4)) for NUCOMP
+thread_local LRUCache<ZZ> ICG2::ClassNumCache;// class numbers
+thread_local LRUCache<Pair<Vec<Pair<ICG2, long> >, long> >
+    ICG2::GeneratorCache;// generators
+
+#define SUBEXP_BOUND  0.4
+#define SUBEXP_MINFB  1000
+#define SUBEXP_RAND   3
+#define SUBEXP_EXPN   31
+#define SUBEXP_EXTRA  10
+#define SUBEXP_STABLE 5
+#define SUBEXP_EULER  (1L<<16)
+
+#define SHANKS_EULER_MIN (1L<<16)
+#define SHANKS_EULER_MAX (1L<<26)
+#define SHANKS_NPRIME    32
+#define SHANKS_RAND      3
+#define SHANKS_TRIAL     20
 
 long IsFundDisc(const NTL::ZZ& a);
+static void SubexpGenerator(Vec<Pair<ICG2, ZZ> >& G, ZZ& h);
+static void ShanksClassNum(ZZ& h, long grh);
 
 void ICG2::init(const ZZ& D) {// set discriminant
     if(!IsFundDisc(D))
@@ -23,26 +45,238 @@ void ICG2::init(const ZZ& D) {// set discriminant
         SqrRoot(amax, amax);
         amax /= 3;
     }
+    abs(L,D);
+    L >>= 2;
+    SqrRoot(L,L);
+    SqrRoot(L,L);
 }
 
-void mul(ICG2& C, const ICG2& A, const ICG2& B) {// C=A*B
-    mul((IDL2&)C, (IDL2&)A, (IDL2&)B);
+ICG2Context::ICG2Context(const ZZ& D_) {// context for D_
+    ICG2Push p;
+    ICG2::init(D_);
+    *this = ICG2Context();
+}
+
+static void form(ZZ& b, ZZ& c, const IDL2& A)
+// (A.a, b, c) = binary quadratic form of primitive ideal A
+// b = 2*A.b.x + (D mod 4), c = (b^2 - D)/(4*A.a)
+{
+    LeftShift(b, A.b.x, 1);
+    b += ZZ2::Dm4;
+    sqr(c,b);
+    c -= ZZ2::D;
+    c /= A.a;
+    c >>= 2;
+}
+
+static void ideal(IDL2& A, const ZZ& a, const ZZ& b)
+// A = primitive ideal of binary quadratic form (a,b,c)
+// assume &a!=&A.a
+{
+    abs(A.a, a);
+    sub(A.b.x, b, ZZ2::Dm4);
+    A.b.x >>= 1;
+    A.b.x %= A.a;
+    set(A.b.y);
+}
+
+static long parteucl(ZZ& d, ZZ& v3, ZZ& v, ZZ& v2)
+// partial extended Euclidean algorithm applied to (d,v3)
+// until |v3| <= ICG2::L, keeping v3 = v2*a (mod d) for initial v3=a
+// return number of division steps
+{
+    long z;
+    ZZ q,r,t;
+    clear(v);
+    set(v2);
+    for(z=0;; z++) {
+        abs(t,v3);
+        if(t <= ICG2::L) break;
+        DivRem(q,r,d,v3);
+        if(sign(r) < 0) { r -= v3; q++; }// 0 <= r < |v3|
+        mul(t,q,v2);
+        sub(t,v,t);
+        v = v2; v2 = t;
+        d = v3; v3 = r;
+    }
+    return z;
+}
+
+static void nucomp(ICG2& C, const ICG2& A, const ICG2& B)
+// C = A*B, assume A and B are primitive
+// compose binary quadratic forms of A and B while
+// partially reducing them, so that intermediate results
+// are kept to the size of |D|**(1/4) (then C is reduced)
+// reference: H. Cohen
+//  "A Course in Computational Algebraic Number Theory"
+//   Algorithm 5.4.9 (NUCOMP)
+{
+    const ICG2 *X(&A), *Y(&B);
+    if(A.a < B.a) { X=&B; Y=&A; }
+    long z;
+    ZZ a1(X->a),a2(Y->a),b1,c1,b2,c2,s,n,d,d1,u,v,u1;
+    ZZ a,b,e,g,l,p1,p2,v2,v3,q1,q2,q3;
+    form(b1,c1,*X);
+    form(b2,c2,*Y);
+    add(s,b1,b2); s >>= 1;
+    sub(n,b2,s);
+    XGCD(d,u,v,a2,a1);// u*a2 + v*a1 = d
+    if(IsOne(d) || divide(s,d)) {
+        mul(a,u,n);
+        negate(a,a);
+        d1 = d;
+        if(!IsOne(d1)) { a1 /= d1; a2 /= d1; s /= d1; }
+    }
+    else {
+        XGCD(d1,u1,l,s,d);// u1*s + l*d = d1
+        if(!IsOne(d1)) { a1 /= d1; a2 /= d1; s /= d1; d /= d1; }
+        rem(p1,c1,d);
+        rem(p2,c2,d);
+        mul(l,u,p1);
+        MulAddTo(l,v,p2);
+        l *= u1;
+        negate(l,l);
+        l %= d;
+        div(p1,a1,d);
+        div(p2,n,d);
+        mul(a,l,p1);
+        MulSubFrom(a,u,p2);
+    }
+    a %= a1;
+    sub(p1,a,a1);
+    if(a > -p1) a = p1;// -a1/2 <= a <= a1/2
+    d = a1; v3 = a;
+    z = parteucl(d,v3,v,v2);
+    if(z==0) {
+        b = a2;
+        mul(a,d,b);
+        LeftShift(q2,b,1);
+        q2 *= v3;
+        q2 += b2;
+    }
+    else {
+        if(z&1) { negate(v3,v3); negate(v2,v2); }
+        mul(b,a2,d);
+        MulAddTo(b,n,v);
+        b /= a1;
+        mul(e,s,d);
+        MulAddTo(e,c2,v);
+        e /= a1;
+        mul(q3,e,v2);
+        LeftShift(q2,q3,1);
+        q2 -= s;
+        if(!IsOne(d1)) { q2 *= d1; v *= d1; }
+        mul(a,d,b);
+        MulAddTo(a,e,v);
+        mul(q1,b,v3);
+        q2 += q1; q2 += q1;
+        q2 += n;
+    }
+    ideal(C,a,q2);
     reduce(C,C);
 }
 
+static void nudupl(ICG2& B, const ICG2& A)
+// B = A*A, assume A is primitive
+// square binary quadratic form of A by one extended gcd
+// and partial reduction (then B is reduced)
+// reference: H. Cohen
+//  "A Course in Computational Algebraic Number Theory"
+//   Algorithm 5.4.8 (NUDUPL)
+{
+    long z;
+    ZZ a(A.a),b,c,d,d1,u,v,v2,v3,e,g,p;
+    form(b,c,A);
+    XGCD(d1,u,v,b,a);// u*b + v*a = d1
+    if(!IsOne(d1)) { a /= d1; b /= d1; }
+    mul(v3,u,c);
+    negate(v3,v3);
+    v3 %= a;
+    sub(p,v3,a);
+    if(v3 > -p) v3 = p;// -a/2 <= v3 <= a/2
+    d = a;
+    z = parteucl(d,v3,v,v2);
+    if(z==0) {
+        sqr(a,d);
+        mul(g,d,v3);
+        LeftShift(g,g,1);
+        MulAddTo(g,b,d1);
+    }
+    else {
+        if(z&1) { negate(v,v); negate(d,d); }
+        mul(e,c,v);
+        MulAddTo(e,b,d);
+        e /= a;
+        mul(p,e,v2);
+        sub(g,p,b);
+        g /= v;
+        MulAddTo(p,v,g);// p = e*v2 + v*g
+        if(!IsOne(d1)) { p *= d1; v *= d1; }
+        sqr(a,d);
+        MulAddTo(a,e,v);
+        mul(g,d,v3);
+        LeftShift(g,g,1);
+        g += p;
+    }
+    ideal(B,a,g);
+    reduce(B,B);
+}
+
+void mul(ICG2& C, const ICG2& A, const ICG2& B) {// C=A*B
+    if(&A==&B) sqr(C,A);
+    else if(IsOne(A.b.y) && IsOne(B.b.y))
+        nucomp(C,A,B);
+    else {
+        mul((IDL2&)C, (IDL2&)A, (IDL2&)B);
+        reduce(C,C);
+    }
+}
+
 void sqr(ICG2& B, const ICG2& A) {// B=A*A
+    if(IsOne(A.b.y)) { nudupl(B,A); return; }
     sqr((IDL2&)B, (IDL2&)A);
     reduce(B,B);
 }
 
-void power(ICG2& B, const ICG2& A, long n) {// B=A^n (n may be n<0)
-    if(n==0) set(B);
-    else if(n<0) { ICG2 C; inv(C,A); power(B,C,-n); }
-    else if(&B==&A) power(B, ICG2(A), n);
-    else {
-        long m((1<<(NumBits(n)-1))>>1);
-        for(B=A; m; m>>=1) { sqr(B,B); if(n&m) B*=A; }
+void power(ICG2& B, const ICG2& A, long n)
+// B=A^n (n may be n<0) by signed sliding window
+{ NAFPower(B,A,n); }
+
+void power(ICG2& B, const ICG2& A, const ZZ& n)
+// B=A^n (n may be n<0) by signed sliding window
+{ NAFPower(B,A,n); }
+
+const IDL2& canonical(const ICG2& A)
+// reduced ideal in class of A, with minimum (a, b.x) for D>0
+{
+    if(!IsZero(A.rep) && A.key == A) return A.rep;
+    A.key = A;
+    reduce(A.rep, A);
+    if(sign(ZZ2::D) < 0) return A.rep;
+    NTL_TLS_LOCAL(CycleWalker, W);
+    NTL_TLS_LOCAL(IDL2, B);
+    NTL_TLS_LOCAL(ZZ, a);
+    NTL_TLS_LOCAL(ZZ, u);
+    W.set(A.rep);
+    a = W.a;
+    u = W.u;
+    for(W.step(); W.a != a || W.u != u; W.step()) {
+        if(W.a > A.rep.a) continue;
+        W.get(B);
+        if(B.a == A.rep.a && B.b.x >= A.rep.b.x) continue;
+        A.rep = B;
     }
+    return A.rep;
+}
+
+size_t hash(const ICG2& A)
+// hash value of reduced ideal in class of A.
+// for D>0, hash value of canonical(A)
+{
+    if(sign(ZZ2::D) > 0) return IDL2Hash()(canonical(A));
+    NTL_TLS_LOCAL(ICG2, B);
+    reduce(B,A);
+    return IDL2Hash()(B);
 }
 
 static void ImQIClassNum(ZZ& h)
@@ -69,46 +303,93 @@ static void ImQIClassNum(ZZ& h)
     }
 }
 
-static void ReQIClassNum(ZZ& h)
-// class number of real quadratic fields
+static long IsLeast(const IDL2& A, long& n)
+// test if reduced ideal A is the least in its cycle,
+// ordered by (a, b.x), and if so, n = length of cycle.
+// cfrac is stopped at the first ideal less than A, so that
+// all ideals in a cycle of length n take O(n log n) steps
+// on average, and no ideal has to be stored.
+// private function, used only internally by ReQIClassNum
+{
+    NTL_TLS_LOCAL(IDL2, B);
+    B = A;
+    for(n=1;; n++) {
+        cfrac(B);
+        if(B == A) return 1;
+        if(B.a < A.a || B.a == A.a && B.b.x < A.b.x) return 0;
+    }
+}
+
+static void ReQIClassNum(ZZ& h, vec_long *l)
+// class number of real quadratic fields.
+// reduced ideals are enumerated by b and divisors a of norm(b+w),
+// and each cycle is counted once at its least ideal (IsLeast),
+// so that memory does not grow with the number of reduced ideals.
+// if l!=0, lengths of cycles are appended to l.
 // reference: J. Buchmann and U. Vollmer
 //  "Binary Quadratic Forms" section 6.17
 {
-    long i,j,k;
+    long i,j,n;
     ZZ r,s,ac;
     Vec<ZZ> a;
     IDL2 A;
-    ZZ2 &q(A.b);
-    std::list<IDL2> L;
-    std::list<IDL2>::iterator p;
+    clear(h);
     if(ZZ2::Dm4 == 0) set(r);
     for(; r <= IDL2::W1; r++) {
         sub(s, IDL2::W1, r);
-        set(q,r,1);
-        norm(ac,q);
+        set(A.b,r,1);
+        norm(ac,A.b);
         divisor(a,ac);
         for(i=0, j=a.length()-1; i<=j; i++, j--) {
             if(a[i] <= s) continue;
-            A.a = a[i]; L.push_back(A);
+            A.a = a[i]; rem(A.b.x, r, A.a);
+            if(IsLeast(A,n)) { h++; if(l) l->append(n); }
             if(i==j) continue;
-            A.a = a[j]; L.push_back(A);
-        }
-    }
-    for(p = L.begin(); p != L.end(); p++)
-        (*p).b.x %= (*p).a;
-    for(clear(h); !L.empty(); h++) {
-        for(A = L.front();; cfrac(A)) {
-            for(p = L.begin(); p != L.end(); p++)
-                if(*p == A) break;
-            if(p == L.end()) break;
-            L.erase(p);            
+            A.a = a[j]; rem(A.b.x, r, A.a);
+            if(IsLeast(A,n)) { h++; if(l) l->append(n); }
         }
     }
 }
 
 void ICG2::ClassNum(ZZ& h) {
-    if(sign(ZZ2::D) < 0) ImQIClassNum(h);
-    else ReQIClassNum(h);
+    ZZ *p(ClassNumCache.find(ZZ2::D));
+    if(p) { h = *p; return; }
+    if(ZZ2L::fits(ZZ2::D)) {// use single precision
+        ICG2L::init();
+        ICG2L::ClassNum(h);
+    }
+    else if(sign(ZZ2::D) < 0) ImQIClassNum(h);
+    else ReQIClassNum(h,0);
+    ClassNumCache.insert(ZZ2::D, h);
+}
+
+void ICG2::ClassNum(ZZ& h, vec_long& l) {
+    l.SetLength(0);
+    if(ZZ2L::fits(ZZ2::D)) {// use single precision
+        ICG2L::init();
+        ICG2L::ClassNum(h,l);
+    }
+    else if(sign(ZZ2::D) < 0) ImQIClassNum(h);
+    else ReQIClassNum(h,&l);
+    ClassNumCache.insert(ZZ2::D, h);
+}
+
+void ICG2::ClassNumParallel(ZZ& h, long n) {
+    ZZ *p(ClassNumCache.find(ZZ2::D));
+    if(p) { h = *p; return; }
+    if(ZZ2L::fits(ZZ2::D)) {// use single precision
+        ICG2L::init();
+        ICG2L::ClassNumParallel(h,n);
+    }
+    else if(sign(ZZ2::D) < 0) ImQIClassNum(h);
+    else ReQIClassNum(h,0);
+    ClassNumCache.insert(ZZ2::D, h);
+}
+
+void ICG2::ClassNumBSGS(ZZ& h, long grh) {
+    ZZ *p(ClassNumCache.find(ZZ2::D));// exact value if cached
+    if(p) { h = *p; return; }
+    ShanksClassNum(h,grh);// heuristic, not cached
 }
 
 void ICG2::ClassNum(ZZ& h, const ZZ& D) {
@@ -117,17 +398,384 @@ void ICG2::ClassNum(ZZ& h, const ZZ& D) {
     ICG2::ClassNum(h);
 }
 
-long generator(Vec<Pair<ICG2, long> >& G, long min)
+void ICG2::ClassNum(ZZ& h, const ICG2Context& c) {
+    ICG2Push p(c);// save old D and set context c
+    ICG2::ClassNum(h);
+}
+
+static double ApproxClassNum(long Q)
+// approximation of class number h for D<0 by
+// h = (w/2) sqrt|D|/pi * prod_{p<Q} (1-(D/p)/p)^(-1)
+// where w = number of units (6 for D=-3, 4 for D=-4, else 2)
+// private function, used only internally by SubexpGenerator
+// and ShanksClassNum
+{
+    long p;
+    double s(0);
+    PrimeSeq ps;
+    while((p = ps.next()) < Q)
+        s -= log(1 - double(IDL2::kron(p))/p);
+    s += 0.5*log(-ZZ2::D) - log(M_PI);
+    if(ZZ2::D == -3) s += log(3.);// multiplied by w/2
+    else if(ZZ2::D == -4) s += log(2.);
+    return exp(s);
+}
+
+static void SubexpGenerator(Vec<Pair<ICG2, ZZ> >& G, ZZ& h)
+// generator of class group for D<0 by relations among
+// prime ideals P[j] in factor base.
+// random power product of P[j] is reduced to ideal (a,b+w),
+// and if a is smooth, (a,b+w) is factored by P[j] or conj(P[j]),
+// which gives a relation of exponents.
+// if a has one large prime factor, two such relations
+// sharing the same large prime are combined.
+// relation matrix is reduced to HNF modulo its determinant d,
+// and more relations are collected for P[j] whose diagonal
+// element in HNF is not 1, until d < hs*sqrt(2), where hs is
+// approximation of h by Euler product.
+// if d > hs/sqrt(2), h = d is accepted, else P[j] do not generate
+// the class group, and factor base is doubled up to Bach bound
+// 6(log|D|)^2 (which suffices under GRH).
+// the result is correct if h is within factor sqrt(2) of hs,
+// which is heuristic; if d does not change by SUBEXP_STABLE times
+// of SUBEXP_EXTRA relations while d >= hs*sqrt(2) (or d=1),
+// or d is too small at Bach bound, raise runtime_error.
+// HNF is converted to generators by SmithNF.
+// reference:
+//   J. L. Hafner and K. S. McCurley, "A rigorous subexponential
+//     algorithm for computation of class groups",
+//     J. Amer. Math. Soc. 2 (1989) 837-850
+//   H. Cohen "A Course in Computational Algebraic Number Theory"
+//     Algorithm 5.5.2
+{
+    if(sign(ZZ2::D) > 0)
+        throw std::runtime_error("D>0 in SubexpGenerator");
+    long i,j,k,l,m,n,p,t,K,B,N;
+    double x, lnD, hs(ApproxClassNum(SUBEXP_EULER));
+    ZZ d,u,q;
+    Vec<long> F,R,X,e;
+    Vec<double> LF;
+    Vec<ICG2> P;
+    Vec<Vec<long> > E;
+    std::unordered_map<long, Vec<long> > H;// partial relations
+    std::unordered_map<long, Vec<long> >::iterator L;
+    mat_ZZ A,W;
+    ICG2 C,Q;
+
+    lnD = log(-ZZ2::D);
+    B = long(exp(SUBEXP_BOUND*sqrt(lnD*log(lnD))));
+    if(B < SUBEXP_MINFB) B = SUBEXP_MINFB;
+    for(;; B<<=1) {
+        F.SetLength(0);
+        R.SetLength(0);
+        LF.SetLength(0);
+        P.SetLength(0);
+        E.SetLength(0);
+        H.clear();
+        PrimeSeq ps;
+        while((p=ps.next()) <= B) {
+            if(IDL2::kron(p) < 0) continue;
+            SetPrime(C,p);
+            F.append(p);
+            LF.append(log(p));
+            R.append(rem(C.b.x, p));
+            reduce(C,C);
+            P.append(C);
+            if(divide(ZZ2::D, p)) {// ramified, P^2 = (p)
+                E.SetLength(E.length()+1);
+                E[E.length()-1].SetLength(F.length()-1, 0);
+                E[E.length()-1].append(2);
+            }
+        }
+        K = F.length();
+        N = K + SUBEXP_EXTRA;
+        e.SetLength(K);
+        X.SetLength(K);
+        for(j=0; j<K; j++) X[j] = j;
+        for(i=0; i<E.length(); i++) E[i].SetLength(K,0);
+        conv(q,B);
+        sqr(q,q);// bound for large prime
+        W.SetDims(0,K);
+        clear(h);
+        for(n=m=0;; N=SUBEXP_EXTRA) {
+            for(l=0; l<N;) {
+                // random power product including P[X[n]]
+                for(j=0; j<K; j++) e[j] = 0;
+                e[X[n%X.length()]] = 1 + RandomBnd(SUBEXP_EXPN);
+                for(k=0; k<SUBEXP_RAND; k++)
+                    e[RandomBnd(K)] += 1 + RandomBnd(SUBEXP_EXPN);
+                for(x=0, j=0; j<K; j++) x += e[j]*LF[j];
+                if(x < lnD) continue;// norm is too small to be reduced
+                for(set(C), j=0; j<K; j++) {
+                    if(e[j]==0) continue;
+                    power(Q, P[j], e[j]);
+                    C *= Q;
+                }
+                if(!IsOne(C.b.y)) continue;
+                // factor (a,b+w) by prime ideals in factor base
+                for(u = C.a, j=0; j<K && !IsOne(u); j++) {
+                    if(!divide(u, p=F[j])) continue;
+                    for(t=0; divide(u,u,p); t++);
+                    if(rem(C.b.x, p) == R[j]) e[j] -= t;
+                    else e[j] += t;
+                }
+                if(!IsOne(u)) {// large prime variation
+                    if(u > q) continue;
+                    conv(p,u);
+                    t = rem(C.b.x, p);
+                    if(t > p-t-ZZ2::Dm4) for(j=0; j<K; j++) e[j] = -e[j];
+                    if((L = H.find(p)) == H.end()) { H[p] = e; continue; }
+                    for(j=0; j<K; j++) e[j] -= L->second[j];
+                    H.erase(L);
+                }
+                for(j=0; j<K && e[j]==0; j++);
+                if(j==K) continue;// trivial relation
+                E.append(e);
+                l++; n++;
+            }
+            // reduce relations to HNF modulo determinant d
+            k = W.NumRows();
+            A.SetDims(k + E.length(), K);
+            for(i=0; i<k; i++) A[i] = W[i];
+            for(i=0; i<E.length(); i++, k++)
+                for(j=0; j<K; j++) conv(A[k][j], E[i][j]);
+            if(W.NumRows() == 0) {
+                // d = determinant of K random combinations of rows
+                W.SetDims(K,K);
+                for(i=0; i<K; i++) {
+                    W[i] = A[i];
+                    for(j=K; j<A.NumRows(); j++)
+                        if(RandomBnd(2)) W[i] += A[j];
+                }
+                determinant(d,W);
+                abs(d,d);
+                if(IsZero(d)) {// rank is deficient
+                    W.SetDims(0,K);
+                    continue;
+                }
+            }
+            E.SetLength(0);
+            HermitNF(W,A,d);
+            for(set(d), X.SetLength(0), i=0; i<K; i++) {
+                d *= W[i][i];
+                if(!IsOne(W[i][i])) X.append(i);
+            }
+            if(conv<double>(d) < hs*M_SQRT2) break;
+            if(X.length() == 0)// d=1 cannot be reduced
+                throw std::runtime_error("SubexpGenerator: h >= hs*sqrt(2)");
+            if(d != h) { h = d; m = 0; }
+            else if(++m >= SUBEXP_STABLE)// d is not changed
+                throw std::runtime_error("SubexpGenerator: h >= hs*sqrt(2)");
+        }
+        if(conv<double>(d) > hs*M_SQRT1_2) break;
+        if(B > 6*lnD*lnD)// d is too small up to Bach bound
+            throw std::runtime_error("SubexpGenerator: h <= hs/sqrt(2)");
+    }
+    h = d;
+    // eliminate generators whose diagonal element is 1
+    Vec<long> J;
+    for(i=K-1; i>=0; i--) {
+        if(!IsOne(W[i][i])) { J.append(i); continue; }
+        for(k=i+1; k<K; k++) {
+            if(IsZero(W[k][i]) || IsOne(W[k][k])) continue;
+            for(j=0; j<i; j++) {
+                MulSubFrom(W[k][j], W[k][i], W[i][j]);
+                rem(W[k][j], W[k][j], h);
+            }
+            clear(W[k][i]);
+        }
+    }
+    // convert to Smith Normal Form
+    mat_ZZ V;
+    vec_ZZ D;
+    l = J.length();
+    A.SetDims(l,l);
+    for(i=0; i<l; i++)
+        for(j=0; j<l; j++) A[i][j] = W[J[l-1-i]][J[l-1-j]];
+    SmithNF(D,V,A,h);
+    for(k=D.length(); k>0; k--)
+        if(D[k-1] > 1) break;
+    G.SetLength(k);
+    for(i=0; i<k; i++) {
+        set(G[i].a);
+        for(j=0; j<l; j++) {
+            rem(u, V[i][j], h);
+            power(C, P[J[l-1-j]], u);
+            G[i].a *= C;
+        }
+        G[i].b = D[i];
+    }
+}
+
+static void ShanksClassNum(ZZ& h, long grh)
+// class number for D<0 by baby-step giant-step.
+// h is approximated by Euler product of Q = |D|**(1/5) primes
+// within interval [lo,hi] of width hs*log|D|/(sqrt(Q)*log(Q)),
+// where hs is the approximation.
+// for random element g, n = e*k in [lo,hi] such that g^n = 1
+// is searched by BSGS of g^e over k, where e is lcm of orders
+// of elements found so far and 2^(t-1) (t = number of prime
+// factors of D, 2^(t-1) divides h by genus theory),
+// so that each search takes O(sqrt((hi-lo)/e)) steps.
+// when e has only one multiple in [lo,hi], it is h,
+// provided that h is in [lo,hi], which is heuristic.
+// if grh!=0, it is checked that P^h = 1 for all prime ideals P
+// with norm <= 6(log|D|)^2, i.e., h is a multiple of exponent
+// of the class group under GRH (this does not prove that
+// h is the order of the class group).
+// if approximation or the check fails, or e is ambiguous
+// after SHANKS_TRIAL elements, h is computed by SubexpGenerator.
+// reference: H. Cohen
+//  "A Course in Computational Algebraic Number Theory"
+//   section 5.4.1 (Shanks's baby-step giant-step method)
+//   and section 5.6.1 (Shanks-Mestre method)
+{
+    if(sign(ZZ2::D) > 0)
+        throw std::runtime_error("D>0 in ShanksClassNum");
+    long i,j,k,m,p,Q;
+    double x, hs, lnD;
+    ZZ lo,hi,e,n,k0,k1,w,r;
+    Vec<Pair<ZZ, long> > f;
+    Vec<ICG2> P;
+    ICG2 g,a,y,z,C;
+    std::unordered_map<IDL2, long, IDL2Hash> T;// baby steps
+    std::unordered_map<IDL2, long, IDL2Hash>::iterator I;
+
+    lnD = log(-ZZ2::D);
+    x = exp(lnD/5);
+    Q = (x < SHANKS_EULER_MIN ? SHANKS_EULER_MIN :
+         x > SHANKS_EULER_MAX ? SHANKS_EULER_MAX : long(x));
+    hs = ApproxClassNum(Q);
+    x = hs*lnD/(sqrt(Q)*log(Q));
+    conv(lo, hs - x);
+    conv(hi, hs + x);
+    if(lo < 1) set(lo);
+    PrimeSeq ps;
+    while(P.length() < SHANKS_NPRIME) {
+        if(IDL2::kron(p = ps.next()) <= 0) continue;
+        SetPrime(C,p);
+        reduce(C,C);
+        P.append(C);
+    }
+    abs(r, ZZ2::D);
+    factor(f,r);
+    power2(e, f.length()-1);
+    for(k=0;; k++) {
+        add(k0, lo, e); k0--; div(k0, k0, e);
+        div(k1, hi, e);
+        if(k0 >= k1 || k >= SHANKS_TRIAL) break;
+        // random element g and a = g^e
+        for(set(g), i=0; i<SHANKS_RAND; i++) {
+            RandomBnd(r,hi);
+            power(C, P[RandomBnd(P.length())], r);
+            g *= C;
+        }
+        power(a,g,e);
+        if(IsOne(a.a)) continue;
+        // baby steps a^j for 0 <= j < m
+        sub(w, k1, k0);
+        SqrRoot(w,w);
+        conv(m, w);
+        m++;
+        T.clear();
+        T.reserve(m);
+        for(clear(n), set(y), j=0; j<m; j++, y*=a) {
+            if(j && IsOne(y.a)) { mul(n, e, j); break; }
+            T.emplace(y, j);
+        }
+        if(IsZero(n)) {
+            // giant steps a^(-k0-i*m) for 0 <= i <= (k1-k0)/m
+            power(z, a, k0);
+            inv(z,z); reduce(z,z);
+            inv(y,y); reduce(y,y);
+            for(w=k0; w<=k1; w+=m, z*=y) {
+                if((I = T.find(z)) == T.end()) continue;
+                add(n, w, I->second);
+                n *= e;
+                break;
+            }
+            if(IsZero(n)) break;// approximation fails
+        }
+        // order of g is minimum divisor n of g^n = 1
+        factor(f,n);
+        for(i=0; i<f.length(); i++) {
+            for(j=0; j<f[i].b; j++) {
+                div(r, n, f[i].a);
+                power(C,g,r);
+                if(!IsOne(C.a)) break;
+                n = r;
+            }
+        }
+        // e = lcm(e,n)
+        GCD(r,e,n);
+        div(n,n,r);
+        e *= n;
+    }
+    if(k0 == k1) {
+        mul(h, e, k0);
+        if(!grh) return;
+        // verify under GRH
+        x = 6*lnD*lnD;
+        ps.reset(0);
+        while((p = ps.next()) <= x) {
+            if(IDL2::kron(p) < 0) continue;
+            SetPrime(C,p);
+            reduce(C,C);
+            power(C,C,h);
+            if(!IsOne(C.a)) break;
+        }
+        if(p > x) return;
+    }
+    // approximation or verification fails
+    Vec<Pair<ICG2, ZZ> > G;
+    SubexpGenerator(G,h);
+}
+
+static long generator_(Vec<Pair<ICG2, long> >& G, long min, long grh)
 // generator of class group
 {
-    if(!ICG2::amax.SinglePrecision())
-        throw std::runtime_error("|D| is too large");
+    if(ZZ2L::fits(ZZ2::D)) {// use single precision
+        long i,k;
+        Vec<Pair<ICG2L, long> > H;
+        ICG2L::init();
+        k = generator(H, min, grh);
+        G.SetLength(H.length());
+        for(i=0; i<H.length(); i++) {
+            conv(G[i].a, H[i].a);
+            G[i].b = H[i].b;
+        }
+        return k;
+    }
     long i,j,k;
-    ICG2 A,B,C;
+    if(sign(ZZ2::D) < 0) {// use relations among prime ideals
+        ZZ h;
+        Vec<Pair<ICG2, ZZ> > H;
+        SubexpGenerator(H,h);
+        G.SetLength(H.length());
+        for(i=0; i<H.length(); i++) {
+            if(!H[i].b.SinglePrecision())
+                throw std::overflow_error("order is too large");
+            G[i].a = H[i].a;
+            conv(G[i].b, H[i].b);
+        }
+        if(!h.SinglePrecision())
+            throw std::overflow_error("class number is too large");
+        return conv<long>(h);
+    }
+    ZZ n(ICG2::amax);
+    if(grh) {// Bach bound
+        double x(log(abs(ZZ2::D)));
+        ZZ y;
+        conv(y, 6*x*x);
+        if(y < n) n = y;
+    }
+    if(!n.SinglePrecision())
+        throw std::runtime_error("|D| is too large");
+    ICG2 A,B;
     Vec<ICG2> P;
     PrimeSeq ps;
     // gather candidates
-    while((k = ps.next()) <= ICG2::amax) {
+    while((k = ps.next()) <= n) {
         if(IDL2::kron(k) < 0) continue;
         SetPrime(A,k);
         reduce(A,A);
@@ -144,19 +792,60 @@ long generator(Vec<Pair<ICG2, long> >& G, long min)
         for(j=1; j<G[i].b; j++) {
             A *= B;
             if(GCD(j, G[i].b) > 1) continue;
+            // minimum in cfrac cycle for D>0
+            if(sign(ZZ2::D) > 0) (IDL2&)A = canonical(A);
             if(A.a < G[i].a.a) G[i].a = A;
-            if(sign(ZZ2::D) < 0) continue;
-            // find a minimum in cfrac cycle for D>0
-            for(cfrac(C=A); (IDL2)C!=A; cfrac(C))
-                if(C.a < G[i].a.a) G[i].a = C;
         }
     }
     return k;
 }
 
+long generator(Vec<Pair<ICG2, long> >& G, long min, long grh)
+// generator of class group, cached for each D if grh==0
+// (cached result of grh==0 is also returned for grh!=0).
+// heuristic result by SubexpGenerator is not cached
+{
+    long i,k(1);
+    Pair<Vec<Pair<ICG2, long> >, long> *p;
+    p = ICG2::GeneratorCache.find(ZZ2::D);
+    if(p && p->b == min) {
+        G = p->a;
+        for(i=0; i<G.length(); i++) k *= G[i].b;
+        return k;
+    }
+    k = generator_(G, min, grh);
+    if(grh || sign(ZZ2::D) < 0 && !ZZ2L::fits(ZZ2::D)) return k;
+    ICG2::GeneratorCache.insert(ZZ2::D, cons(G, min));
+    ICG2::ClassNumCache.insert(ZZ2::D, ZZ(k));
+    return k;
+}
+
+void generator(Vec<Pair<ICG2, ZZ> >& G, ZZ& h)
+// generator of class group with orders of multiple precision
+{
+    if(sign(ZZ2::D) < 0 && !ZZ2L::fits(ZZ2::D)) {
+        SubexpGenerator(G,h);// heuristic, not cached
+        return;
+    }
+    long i;
+    Vec<Pair<ICG2, long> > H;
+    conv(h, generator(H));
+    G.SetLength(H.length());
+    for(i=0; i<H.length(); i++) {
+        G[i].a = H[i].a;
+        conv(G[i].b, H[i].b);
+    }
+}
+
 long generator(Vec<Pair<ICG2, long> >& G,
-               const ZZ& D, long min) {
+               const ZZ& D, long min, long grh) {
     ICG2Push p;// save old D
     ICG2::init(D);// set new discriminant
-    return generator(G, min);
+    return generator(G, min, grh);
+}
+
+long generator(Vec<Pair<ICG2, long> >& G,
+               const ICG2Context& c, long min, long grh) {
+    ICG2Push p(c);// save old D and set context c
+    return generator(G, min, grh);
 }
\ No newline at end of file
@@ -6,32 +6,91 @@
 
 #include "IDL2.h"
 #include<NTL/pair.h>
+#include<NTL/vec_long.h>
+
+struct ICG2Context;
 
 struct ICG2 : IDL2
 // Ideal Class Group in Quadratic fields
 {
-    static NTL::ZZ amax; // Minkowski bound for a
+    mutable IDL2 rep,key;// rep = canonical(key), cache of canonical(*this)
+    static thread_local NTL::ZZ amax; // Minkowski bound for a
+    static thread_local NTL::ZZ L; // floor(|D/4|**(1/4)) for NUCOMP
+    static thread_local LRUCache<NTL::ZZ> ClassNumCache;
+    // cache of class numbers computed by ClassNum and generator
+    static thread_local LRUCache<NTL::Pair<NTL::Vec<NTL::Pair<ICG2, long> >,
+                                           long> > GeneratorCache;
+    // cache of (G,min) computed by generator(G,min)
     static void init(const NTL::ZZ& D);// set discriminant D
     // if D is not fundamental, raise rutime_error
     static void init(long D) { init(NTL::ZZ(D)); }
     static void ClassNum(NTL::ZZ& h);
+    static void ClassNum(NTL::ZZ& h, NTL::vec_long& l);
+    // h = class number, l[i] = length of i-th cycle of
+    // reduced ideals for D>0 (l is empty for D<0)
+    static void ClassNumParallel(NTL::ZZ& h, long n=0);
+    // h = class number computed by n threads for |D| < 2**62
+    // (if n<=0, by number of hardware threads)
+    static void ClassNumBSGS(NTL::ZZ& h, long grh=0);
+    // h = class number for D<0 computed by baby-step giant-step
+    // in O(|D|**(1/5)) steps, starting from Euler product
+    // approximation of h (if fails, fall back on relations).
+    // h is heuristic, i.e., correct if the true class number is
+    // in the interval given by Euler product, and is not cached
+    // (exact value cached by ClassNum is returned if any).
+    // if grh!=0, it is also checked that h is a multiple of
+    // exponent of class group assuming GRH (not a proof of h)
+    // if D>0, or fallback on relations fails, raise runtime_error
     static void ClassNum(NTL::ZZ& h, const NTL::ZZ& D);
     // h = class number of new discriminant D
     // old value of D is restored on exit
+    static void ClassNum(NTL::ZZ& h, const ICG2Context& c);
+    // h = class number for discriminant context c
 };
 
-struct ICG2Push : IDL2Push {
-    NTL::ZZ amax;
-    ICG2Push() : amax(ICG2::amax) {;}
-    // save current values of D,D4,Dm4,S,W,W1,amax
-    ~ICG2Push() { ICG2::amax=amax; }
+struct ICG2Context : IDL2Context
+// discriminant context D,D4,Dm4,S,W,W1,amax,L of ICG2
+// e.g., to compute class numbers in parallel threads,
+//   ICG2Context c(D);// in main thread
+//   ICG2::ClassNum(h,c);// in each worker thread
+{
+    NTL::ZZ amax,L;
+    ICG2Context() : amax(ICG2::amax), L(ICG2::L) {;}
+    // save current values of D,D4,Dm4,S,W,W1,amax,L
+    explicit ICG2Context(const NTL::ZZ& D);
+    // context for discriminant D (current values are unchanged)
+    // if D is not fundamental, raise rutime_error
+    void restore() const
+    { IDL2Context::restore(); ICG2::amax=amax; ICG2::L=L; }
+    // set D,D4,Dm4,S,W,W1,amax,L of current thread to saved values
+};
+
+struct ICG2Push : ICG2Context {
+    ICG2Push() {;}// save current values of D,D4,Dm4,S,W,W1,amax,L
+    ICG2Push(const ICG2Context& c) { c.restore(); }
+    // save current values and set context c
+    ~ICG2Push() { restore(); }
     // restore old values when this object is destructed
 };
 
+const IDL2& canonical(const ICG2& A);
+// canonical ideal in class of A, i.e., reduced ideal of A for D<0,
+// and reduced ideal with minimum (a, b.x) in cfrac cycle for D>0.
+// result is cached in A (recomputed if A is changed),
+// so that A must not be shared by threads. assume A!=0
+
 inline long operator==(const ICG2& A, const ICG2& B)
-{ return IsEquiv(A,B); }// test equivalence of A and B
+// test equivalence of A and B
+{
+    if(sign(ZZ2::D) < 0 || IsZero(A) || IsZero(B)) return IsEquiv(A,B);
+    return canonical(A) == canonical(B);
+}
 inline long operator!=(const ICG2& A, const ICG2& B)
-{ return !IsEquiv(A,B); }
+{ return !(A==B); }
+
+size_t hash(const ICG2& A);
+// hash value of ideal class of A (A==B implies hash(A)==hash(B)),
+// e.g., for GroupGenerator
 
 inline long IsUnit(const ICG2& A)
 { return IsPrincipal(A); }// test principality of A
@@ -40,22 +99,53 @@ inline void inv(ICG2& B, const ICG2& A) { conj(B,A); }
 // B = inverse class of A
 
 void mul(ICG2& C, const ICG2& A, const ICG2& B);// C=A*B
+// if A and B are primitive, use NUCOMP
 void sqr(ICG2& B, const ICG2& A);// B=A*A
+// if A is primitive, use NUDUPL
 
 inline void operator*=(ICG2& B, const ICG2& A) { mul(B,B,A); }// B=B*A
                                                      
 void power(ICG2& B, const ICG2& A, long n);// B=A^n (n may be n<0)
+// by signed sliding window, inverse is given by conj
+void power(ICG2& B, const ICG2& A, const NTL::ZZ& n);// same for ZZ n
 
-long generator(NTL::Vec<NTL::Pair<ICG2, long> >& G, long min=1);
+long generator(NTL::Vec<NTL::Pair<ICG2, long> >& G,
+               long min=1, long grh=0);
 // generator of class group
 // G = vector of (generator, order) pair
 // return class number = product of G[i].b
 // if min==1, group representatives are
 //    chosen from ideals of minimum value of a
+// if grh==0, G is generated from prime ideals of norm <= amax,
+//    and if grh!=0, from those of norm <= 6(log|D|)^2
+//    (Bach bound), so that G is correct ONLY ASSUMING GRH.
+//    result of grh!=0 is not cached, and it may be verified
+//    unconditionally in background, e.g., by
+//      ICG2Context c(D);
+//      auto f = std::async(std::launch::async,
+//        [&](){ return generator(H,c,min); });// grh=0
+//      k = generator(G,D,min,1);// while f is running
+// for D<0 and |D| >= 2**62, G is computed from relations
+//    among prime ideals and min and grh are ignored
+//    (if class number >= 2**63, raise overflow_error);
+//    the result is heuristic as below and is not cached
+
+void generator(NTL::Vec<NTL::Pair<ICG2, NTL::ZZ> >& G, NTL::ZZ& h);
+// generator of class group, h = class number
+// G = vector of (generator, order) pair
+// for D<0 and |D| >= 2**62, computed by relations among
+// prime ideals in subexponential time, assuming that
+// Euler product approximates h within factor sqrt(2)
+// (if it is found not to, raise runtime_error).
+// this heuristic result is not cached
 
 long generator(NTL::Vec<NTL::Pair<ICG2, long> >& G,
-               const NTL::ZZ& D, long min=1);
+               const NTL::ZZ& D, long min=1, long grh=0);
 // generator of class group of new discriminant D
 // old value of D is restored on exit
 
+long generator(NTL::Vec<NTL::Pair<ICG2, long> >& G,
+               const ICG2Context& c, long min=1, long grh=0);
+// generator of class group for discriminant context c
+
 #endif // __IDL2ClassGroup_h__
\ No newline at end of file
@@ -0,0 +1,584 @@
+// uses NTL
+//   http://www.shoup.net/ntl
+
+#include "IDL2L.h"
+#include "GroupGenerator.h"
+#include "WindowPower.h"
+#include "ZZFactoring.h"
+#include<algorithm>
+#include<thread>
+#include<atomic>
+using namespace NTL;
+
+#define SIEVE_LENGTH (1L<<16)// segment length of sieve in ReducedForms
+#define THREAD_CHUNK (1L<<12)// number of r taken at once by a thread
+
+long Jacobi(long, long);
+long SqrRootMod(long, long);
+
+thread_local long ZZ2L::D;// discriminant
+thread_local long ZZ2L::D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
+thread_local long ZZ2L::Dm4;// D mod 4
+thread_local long IDL2L::S;// floor(sqrt(D)) (used only for D>0)
+thread_local long IDL2L::W;// floor(w) (used only for D>0)
+thread_local long IDL2L::W1;// floor(-conj(w)) (used only for D>0)
+thread_local long ICG2L::amax;// Minkowski bound for a
+
+typedef __int128 LL;
+
+static long narrow(LL a)
+// return a as long; if a does not fit in long, raise overflow_error
+{
+    if(a != (long)a) throw std::overflow_error("ZZ2L overflow");
+    return (long)a;
+}
+
+static long narrow(const ZZ& a)
+{
+    if(!a.SinglePrecision()) throw std::overflow_error("ZZ2L overflow");
+    return conv<long>(a);
+}
+
+static long rem(long a, long m)// a mod m, assume m>0
+{ a %= m; return (a<0 ? a+m : a); }
+
+long ZZ2L::fits(const ZZ& D) { return NumBits(D) <= 62; }
+
+void ZZ2L::init() {// copy discriminant
+    if(!fits(ZZ2::D)) throw std::overflow_error("|D| is too large");
+    conv(D, ZZ2::D);
+    conv(D4, ZZ2::D4);
+    Dm4 = ZZ2::Dm4;
+}
+
+void IDL2L::init() {// copy discriminant
+    ZZ2L::init();
+    if(ZZ2L::D < 0) return;
+    conv(S, IDL2::S);
+    conv(W, IDL2::W);
+    conv(W1, IDL2::W1);
+}
+
+void ICG2L::init() {// copy discriminant
+    IDL2L::init();
+    conv(amax, ICG2::amax);
+}
+
+void conv(ZZ2L& b, const ZZ2& a) { b.x = narrow(a.x); b.y = narrow(a.y); }
+void conv(ZZ2& b, const ZZ2L& a) { conv(b.x, a.x); conv(b.y, a.y); }
+
+void negate(ZZ2L& b, const ZZ2L& a) { b.x = -a.x; b.y = -a.y; }// b=-a
+
+void conj(ZZ2L& b, const ZZ2L& a) {// replace sqrt(D) by -sqrt(D)
+    b.x = narrow(LL(a.x) + ZZ2L::Dm4*a.y);
+    b.y = -a.y;
+}
+
+static LL norm(const ZZ2L& a)// norm of a in double word
+{
+    LL n(LL(a.x)*a.x);
+    if(ZZ2L::Dm4) n += LL(a.x)*a.y;
+    return n - LL(a.y)*a.y*ZZ2L::D4;
+}
+
+void norm(long& n, const ZZ2L& a) { n = narrow(norm(a)); }
+
+void add(ZZ2L& c, const ZZ2L& a, const ZZ2L& b) {// c=a+b
+    c.x = narrow(LL(a.x) + b.x);
+    c.y = narrow(LL(a.y) + b.y);
+}
+
+void sub(ZZ2L& c, const ZZ2L& a, const ZZ2L& b) {// c=a-b
+    c.x = narrow(LL(a.x) - b.x);
+    c.y = narrow(LL(a.y) - b.y);
+}
+
+void mul(ZZ2L& c, const ZZ2L& a, const ZZ2L& b) {// c=a*b
+    LL t(LL(a.y)*b.y);
+    LL y(LL(a.x)*b.y + LL(a.y)*b.x);
+    if(ZZ2L::Dm4) y += t;
+    c.x = narrow(LL(a.x)*b.x + t*ZZ2L::D4);
+    c.y = narrow(y);
+}
+
+void mul(ZZ2L& c, const ZZ2L& a, long b) {// c=a*b
+    c.x = narrow(LL(a.x)*b);
+    c.y = narrow(LL(a.y)*b);
+}
+
+void sqr(ZZ2L& b, const ZZ2L& a) { mul(b,a,a); }// b = a*a
+
+std::ostream& operator<<(std::ostream& s, const ZZ2L& a) {
+    s << '[' << a.x << ' ' << a.y << ']';
+    return s;
+}
+
+void conv(IDL2L& B, const IDL2& A) { B.a = narrow(A.a); conv(B.b, A.b); }
+void conv(IDL2& B, const IDL2L& A) { conv(B.a, A.a); conv(B.b, A.b); }
+
+void conj(IDL2L& B, const IDL2L& A) {// B = conjugate of A, 0<=B.b.x<B.a
+    B.a = A.a;
+    B.b.x = rem(-A.b.x - ZZ2L::Dm4*A.b.y, A.a);
+    B.b.y = A.b.y;
+}
+
+void norm(long& n, const IDL2L& A) { n = narrow(LL(A.a)*A.b.y); }
+
+void primitive(IDL2L& B, const IDL2L& A) {// B = primitive part of A
+    if(&B!=&A) B=A;
+    if(IsZero(A) || A.b.y == 1) return;
+    B.a /= A.b.y;
+    B.b.x /= A.b.y;
+    B.b.y = 1;
+}
+
+static void MulZZ(IDL2L& C, const IDL2L& A, const IDL2L& B)
+// C = A*B by multiprecision IDL2
+// (if C does not fit in long, raise overflow_error)
+// private function, used only internally by mul
+{
+    IDL2 E,F;
+    conv(E,A);
+    conv(F,B);
+    mul(E,E,F);
+    conv(C,E);
+}
+
+static long IsInvertible(long a, long b)
+// test if primitive ideal with a and b = 2*b.x + Dm4 is invertible
+// (same as IsInvertible for IDL2)
+// private function, used only internally by mul
+{
+    long c(narrow((LL(b)*b - ZZ2L::D)/(LL(a)<<2)));
+    return GCD(GCD(a,b),c) == 1;
+}
+
+void mul(IDL2L& C, const IDL2L& A, const IDL2L& B)
+// C = A*B by composition of primitive parts.
+// if d>1 and A or B is not invertible (D is not fundamental),
+// composition is not valid and C is computed by MulZZ.
+// bit sizes of operands are checked before intermediate products,
+// and if they may overflow __int128, C is computed by MulZZ
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    Lemma 5.4.5, Definition 5.4.6
+{
+    if(IsZero(A) ||
+       IsZero(B)) { clear(C); return; }
+    if(IsUnit(A)) { if(&C!=&B) C=B; return; }
+    if(IsUnit(B)) { if(&C!=&A) C=A; return; }
+    if(NumBits(A.a) > 61 ||
+       NumBits(B.a) > 61) { MulZZ(C,A,B); return; }
+    long a1(A.a/A.b.y), b1(((A.b.x/A.b.y)<<1) + ZZ2L::Dm4);
+    long a2(B.a/B.b.y), b2(((B.b.x/B.b.y)<<1) + ZZ2L::Dm4);
+    long d,u,v,w,s((b1+b2)>>1);
+    XGCD(d,u,v,a1,a2);// d = u*a1 + v*a2
+    if(s%d) {
+        long e;
+        XGCD(d,e,w,d,s);// d = gcd(a1,a2,s)
+        if(NumBits(u) + NumBits(e) > 62 ||
+           NumBits(v) + NumBits(e) > 62) { MulZZ(C,A,B); return; }
+        u *= e; v *= e;
+    }
+    else w = 0;
+    if(d > 1 && (!IsInvertible(a1,b1) ||
+                 !IsInvertible(a2,b2))) { MulZZ(C,A,B); return; }
+    if(NumBits(u) + NumBits(a1) + NumBits(b2) > 125 ||
+       NumBits(v) + NumBits(a2) + NumBits(b1) > 125 ||
+       std::max(NumBits(b1) + NumBits(b2), 62L) + NumBits(w) > 125 ||
+       NumBits(A.b.y) + NumBits(B.b.y) + NumBits(d) > 63)
+    { MulZZ(C,A,B); return; }
+    LL a3(LL(a1/d)*(a2/d)), m(LL(A.b.y)*B.b.y*d);
+    LL b3(u*LL(a1)*b2 + v*LL(a2)*b1);
+    if(w) b3 += (LL(b1)*b2 + ZZ2L::D)/2*w;
+    b3 /= d; b3 %= a3<<1;
+    if(b3 < 0) b3 += a3<<1;
+    C.a = narrow(narrow(a3)*m);
+    C.b.x = narrow((b3 - ZZ2L::Dm4)/2*m);
+    C.b.y = narrow(m);
+}
+
+void sqr(IDL2L& B, const IDL2L& A) { mul(B,A,A); }// B = A*A
+
+static void normalize(IDL2L& B, const IDL2L& A)
+// same as normalize for IDL2.
+// assume A is primitive and A!=0.
+{
+    if(ZZ2L::D < 0 || A.a > IDL2L::S) {
+        long n((A.b.x<<1) + ZZ2L::Dm4);
+        B.b.x = (n > A.a ? A.b.x - A.a : A.b.x);
+    }
+    else B.b.x = IDL2L::W1 - rem(IDL2L::W1 - A.b.x, A.a);
+    B.b.y = 1;
+    LL n(norm(B.b)/A.a);
+    B.a = narrow(n<0 ? -n : n);
+}
+
+static long IsReduced(long a, long b, long c)
+// same as IsReduced for IDL2
+{
+    if(ZZ2L::D < 0)
+        return a<c || a==c && b >= 0;
+    else return a-b <= IDL2L::W;
+}
+
+long cfrac(IDL2L& A, long red)
+// continued fraction expansion.
+// assume A is primitive and A!=0
+{
+    IDL2L B;
+    normalize(B,A);
+    if(red && IsReduced(A.a, B.b.x, B.a))
+        return 1;
+    A.a = B.a;
+    A.b.x = rem(-B.b.x - ZZ2L::Dm4, A.a);
+    A.b.y = 1;
+    return 0;
+}
+
+void reduce(IDL2L& B, const IDL2L& A)
+// B = reduction of primitive part of A
+// assume A!=0
+{
+    primitive(B,A);
+    while(cfrac(B,1) == 0) {;}
+}
+
+long IsEquiv(const IDL2L& A, const IDL2L& B)
+// test if A and B are equivalent
+{
+    if(IsZero(A) || IsZero(B)) return 1;
+    IDL2L C,D;
+    reduce(C,A);
+    reduce(D,B);
+    if(C==D) return 1;
+    if(ZZ2L::D < 0) return 0;
+    IDL2L E(C);
+    for(cfrac(C); C!=D; cfrac(C))
+        if(C==E) return 0;
+    return 1;
+}
+
+long IsPrincipal(const IDL2L& A)
+// test if A is principal ideal
+{
+    if(IsZero(A)) return 1;
+    IDL2L B;
+    reduce(B,A);
+    if(IsUnit(B)) return 1;
+    if(ZZ2L::D < 0) return 0;
+    IDL2L C(B);
+    for(cfrac(B); !IsUnit(B); cfrac(B))
+        if(B==C) return 0;
+    return 1;
+}
+
+size_t IDL2LHash::operator()(const IDL2L& A) const
+// hash value of A from A.a and A.b
+{
+    size_t h(A.a);
+    h = h*1000003 ^ A.b.x;
+    return h*1000003 ^ A.b.y;
+}
+
+std::ostream& operator<<(std::ostream& s, const IDL2L& A) {
+    s << '[' << A.a << ' ' << A.b << ']';
+    return s;
+}
+
+void ReducedForms::init()
+// set up primes p <= sqrt(max of ac) and roots of ac mod p
+{
+    long l,p,q,x,y;
+    PrimeSeq ps;
+    s = SqrRoot(-ZZ2L::D/3);
+    s = (s - ZZ2L::Dm4) >> 1;// |b| <= a <= sqrt(|D|/3)
+    l = SqrRoot(s*s + s*ZZ2L::Dm4 - ZZ2L::D4);// sqrt(max of ac)
+    P.SetLength(0);
+    R.SetLength(0);
+    while((p = ps.next()) && p <= l) {
+        if(p==2) {
+            for(x=0; x<2; x++) {
+                if((x*x + x*ZZ2L::Dm4 - ZZ2L::D4) & 1) continue;
+                P.append(p);
+                R.append(x);
+            }
+            continue;
+        }
+        q = rem(ZZ2L::D, p);
+        if(Jacobi(q,p) < 0) continue;
+        y = SqrRootMod(q,p);
+        for(x = y;; x = p-y) {// (2r + (D mod 4))^2 = D (mod p)
+            P.append(p);
+            R.append(rem((x - ZZ2L::Dm4)*((p+1)>>1), p));
+            if(x == p-y || y == 0) break;
+        }
+    }
+    range(0,s);
+}
+
+void ReducedForms::range(long r1, long r2)
+// restart sieve from r1
+{
+    long h;
+    t = min(r2,s);
+    r = r0 = r1-1;
+    Q.SetLength(P.length());
+    for(h=0; h<P.length(); h++)
+        Q[h] = r1 + rem(R[h] - r1, P[h]);
+    n.SetLength(0);
+    d.SetLength(0);
+    j = 0;
+}
+
+long ReducedForms::next()
+// move to next divisor a in d, or to next r whose divisors
+// are generated from prime factors, r is sieved by segments
+{
+    long h,i,l,p,q,x,y;
+    while(j >= 2*d.length()) {
+        if(++r > t) return 0;
+        if((i = r - r0) >= n.length()) {// sieve next segment
+            r0 = r;
+            l = min(SIEVE_LENGTH, t - r0 + 1);
+            n.SetLength(l);
+            m.SetLength(l);
+            k.SetLength(l);
+            f.SetLength(16*l);
+            for(i=0; i<l; i++) {
+                x = r0 + i;
+                m[i] = n[i] = x*x + x*ZZ2L::Dm4 - ZZ2L::D4;
+                k[i] = 0;
+            }
+            for(h=0; h<P.length(); h++) {
+                p = P[h];
+                for(x = Q[h]; x < r0 + l; x += p) {
+                    i = x - r0;
+                    do m[i] /= p; while(m[i]%p == 0);
+                    f[16*i + k[i]++] = p;
+                }
+                Q[h] = x;
+            }
+            for(i=0; i<l; i++)
+                if(m[i] > 1) f[16*i + k[i]++] = m[i];
+            i = 0;
+        }
+        // divisors a of ac with 2r + (D mod 4) <= a <= c
+        d.SetLength(1);
+        d[0] = 1;
+        for(h=0; h<k[i]; h++) {
+            p = f[16*i + h];
+            l = d.length();
+            for(y = n[i]/p, q = p;; q *= p, y /= p) {
+                for(x=0; x<l; x++) d.append(d[x]*q);
+                if(y%p) break;
+            }
+        }
+        b = (r<<1) + ZZ2L::Dm4;
+        for(h=x=0; h<d.length(); h++)
+            if(d[h] >= b && d[h] <= n[i]/d[h]) d[x++] = d[h];
+        d.SetLength(x);
+        j = 0;
+    }
+    a = d[j>>1];
+    c = n[r - r0]/a;
+    b = (r<<1) + ZZ2L::Dm4;
+    if(j&1) { b = -b; j++; }
+    else if(b == 0 || b == a || a == c) j += 2;// (a,-b,c) is not reduced
+    else j++;
+    return 1;
+}
+
+void mul(ICG2L& C, const ICG2L& A, const ICG2L& B) {// C=A*B
+    try { mul((IDL2L&)C, (IDL2L&)A, (IDL2L&)B); }
+    catch(std::overflow_error&) {// use multiprecision
+        ICG2 E,F;
+        conv(E,A);
+        conv(F,B);
+        mul(E,E,F);
+        conv(C,E);
+        return;
+    }
+    reduce(C,C);
+}
+
+void sqr(ICG2L& B, const ICG2L& A) { mul(B,A,A); }// B=A*A
+
+void power(ICG2L& B, const ICG2L& A, long n)
+// B=A^n (n may be n<0) by signed sliding window
+{ NAFPower(B,A,n); }
+
+const IDL2L& canonical(const ICG2L& A)
+// reduced ideal in class of A, with minimum (a, b.x) for D>0
+{
+    if(!IsZero(A.rep) && A.key == A) return A.rep;
+    A.key = A;
+    reduce(A.rep, A);
+    if(ZZ2L::D < 0) return A.rep;
+    IDL2L B(A.rep), E(A.rep);
+    for(cfrac(B); B != E; cfrac(B))
+        if(B.a < A.rep.a || B.a == A.rep.a && B.b.x < A.rep.b.x) A.rep = B;
+    return A.rep;
+}
+
+size_t hash(const ICG2L& A)
+// hash value of reduced ideal in class of A.
+// for D>0, hash value of canonical(A)
+{
+    if(ZZ2L::D > 0) return IDL2LHash()(canonical(A));
+    IDL2L B;
+    reduce(B,A);
+    return IDL2LHash()(B);
+}
+
+static void ImQIClassNum(ZZ& h)
+// class number of imaginary quadratic fields
+// by counting reduced forms enumerated by sieve
+{
+    long k(0);
+    for(ReducedForms F; F.next();) k++;
+    conv(h,k);
+}
+
+static long IsLeast(const IDL2L& A, long& n)
+// test if reduced ideal A is the least in its cycle,
+// ordered by (a, b.x), and if so, n = length of cycle.
+// cfrac is stopped at the first ideal less than A, so that
+// all ideals in a cycle of length n take O(n log n) steps
+// on average, and no ideal has to be stored.
+// private function, used only internally by CountCycles
+{
+    IDL2L B(A);
+    for(n=1;; n++) {
+        cfrac(B);
+        if(B == A) return 1;
+        if(B.a < A.a || B.a == A.a && B.b.x < A.b.x) return 0;
+    }
+}
+
+static long CountCycles(long r1, long r2, vec_long *l)
+// return number of cycles of reduced ideals whose least ideal
+// aZ + (b+w)Z has r1 <= b <= r2, where b is normalized as in
+// cfrac, i.e., W1 - a < b <= W1.
+// reduced ideals are enumerated by b and divisors a of norm(b+w),
+// and each cycle is counted once at its least ideal (IsLeast).
+// if l!=0, lengths of cycles are appended to l.
+// private function, used only internally by ReQIClassNum
+{
+    long i,j,k(0),n,r,s,ac;
+    vec_long a;
+    IDL2L A;
+    r2 = min(r2, IDL2L::W1);
+    for(r = max(r1, 1-ZZ2L::Dm4); r <= r2; r++) {
+        s = IDL2L::W1 - r;
+        set(A.b,r,1);
+        norm(ac,A.b);
+        divisor(a,ac);
+        for(i=0, j=a.length()-1; i<=j; i++, j--) {
+            if(a[i] <= s) continue;
+            A.a = a[i]; A.b.x = r%A.a;
+            if(IsLeast(A,n)) { k++; if(l) l->append(n); }
+            if(i==j) continue;
+            A.a = a[j]; A.b.x = r%A.a;
+            if(IsLeast(A,n)) { k++; if(l) l->append(n); }
+        }
+    }
+    return k;
+}
+
+static void ReQIClassNum(ZZ& h, vec_long *l)
+// class number of real quadratic fields
+// same as ReQIClassNum for ICG2
+{ conv(h, CountCycles(0, IDL2L::W1, l)); }
+
+void ICG2L::ClassNum(ZZ& h) {
+    if(ZZ2L::D < 0) ImQIClassNum(h);
+    else ReQIClassNum(h,0);
+}
+
+void ICG2L::ClassNum(ZZ& h, vec_long& l) {
+    l.SetLength(0);
+    if(ZZ2L::D < 0) ImQIClassNum(h);
+    else ReQIClassNum(h,&l);
+}
+
+void ICG2L::ClassNumParallel(ZZ& h, long n)
+// range of r (|b| = 2r + (D mod 4) for D<0, or b = r for D>0)
+// is split into chunks, which are taken one by one by threads
+// as they become idle, so that loads of threads are balanced.
+// numbers of reduced forms (D<0) or cycles (D>0) in chunks
+// are added up.
+{
+    long i;
+    if(n <= 0) n = std::thread::hardware_concurrency();
+    if(n <= 1) { ClassNum(h); return; }
+    ICG2Context c;// current discriminant passed to threads
+    std::atomic<long> next(0), count(0);
+    std::vector<std::thread> T;
+    if(ZZ2L::D < 0) {
+        ReducedForms F;// primes and roots shared by threads
+        for(i=0; i<n; i++) T.push_back(std::thread([&]() {
+            ICG2Push p(c);
+            ICG2L::init();
+            ReducedForms G(F);
+            long k(0), r;
+            while((r = next.fetch_add(SIEVE_LENGTH)) <= F.s)
+                for(G.range(r, r + SIEVE_LENGTH - 1); G.next(); k++);
+            count += k;
+        }));
+        for(i=0; i<n; i++) T[i].join();
+        conv(h, count);
+        return;
+    }
+    for(i=0; i<n; i++) T.push_back(std::thread([&]() {
+        ICG2Push p(c);
+        ICG2L::init();
+        long k(0), r;
+        while((r = next.fetch_add(THREAD_CHUNK)) <= IDL2L::W1)
+            k += CountCycles(r, r + THREAD_CHUNK - 1, 0);
+        count += k;
+    }));
+    for(i=0; i<n; i++) T[i].join();
+    conv(h, count);
+}
+
+long generator(Vec<Pair<ICG2L, long> >& G, long min, long grh)
+// generator of class group
+{
+    long i,j,k,n(ICG2L::amax);
+    double x;
+    ICG2 A;
+    ICG2L B,E;
+    Vec<ICG2L> P;
+    PrimeSeq ps;
+    if(grh) {// Bach bound
+        x = log(fabs(double(ZZ2L::D)));
+        x *= 6*x;
+        if(x < n) n = long(x);
+    }
+    // gather candidates
+    while((k = ps.next()) <= n) {
+        if(IDL2::kron(k) < 0) continue;
+        SetPrime(A,k);
+        conv(B,A);
+        reduce(B,B);
+        P.append(B);
+    }
+    G.SetLength(0);
+    if(P.length() == 0) return 1;
+    k = GroupGenerator(G,P);// utilize general routine
+    if(!min) return k;
+    // find minimum generators
+    for(i=0; i<G.length(); i++) {
+        set(E);
+        B = G[i].a;
+        for(j=1; j<G[i].b; j++) {
+            E *= B;
+            if(GCD(j, G[i].b) > 1) continue;
+            // minimum in cfrac cycle for D>0
+            if(ZZ2L::D > 0) (IDL2L&)E = canonical(E);
+            if(E.a < G[i].a.a) G[i].a = E;
+        }
+    }
+    return k;
+}
\ No newline at end of file
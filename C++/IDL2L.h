@@ -0,0 +1,186 @@
+// uses NTL
+//   http://www.shoup.net/ntl
+
+#ifndef __IDL2L_h__
+#define __IDL2L_h__
+
+#include "IDL2ClassGroup.h"
+#include<NTL/vec_long.h>
+#include<stdexcept>
+
+struct ZZ2L
+// Quadratic Integer x + yw with single precision components
+// for discriminants |D| < 2**62.
+// intermediate results are computed in __int128, and
+// if a result does not fit in long, raise overflow_error
+{
+    long x,y;// components of x+yw
+    static thread_local long D;// discriminant
+    static thread_local long D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
+    static thread_local long Dm4;// D mod 4 (0 or 1)
+    static void init();// copy current value of ZZ2::D
+    // if |ZZ2::D| >= 2**62, raise overflow_error
+    static long fits(const NTL::ZZ& D);// test if |D| < 2**62
+    ZZ2L() : x(0), y(0) {;}
+    ZZ2L(long a, long b) : x(a), y(b) {;}
+    ZZ2L(long a) : x(a), y(0) {;} // y=0
+};
+
+void conv(ZZ2L& b, const ZZ2& a);// b = a; may raise overflow_error
+void conv(ZZ2& b, const ZZ2L& a);// b = a
+
+inline void clear(ZZ2L& a) { a.x = a.y = 0; }// a=0+0w
+inline void set(ZZ2L& a) { a.x = 1; a.y = 0; }// a=1+0w
+inline void set(ZZ2L& a, long x, long y) { a.x = x; a.y = y; }// a=x+yw
+void negate(ZZ2L& b, const ZZ2L& a);// b=-a
+void conj(ZZ2L& b, const ZZ2L& a);// b = conjugate of a
+void norm(long& n, const ZZ2L& a);// n = a*conj(a)
+
+inline long IsZero(const ZZ2L& a) { return a.x==0 && a.y==0; }
+
+void add(ZZ2L& c, const ZZ2L& a, const ZZ2L& b);// c = a+b
+void sub(ZZ2L& c, const ZZ2L& a, const ZZ2L& b);// c = a-b
+void mul(ZZ2L& c, const ZZ2L& a, const ZZ2L& b);// c = a*b
+void mul(ZZ2L& c, const ZZ2L& a, long b);// c = a*b
+void sqr(ZZ2L& b, const ZZ2L& a);// b = a*a
+
+inline long operator==(const ZZ2L& a, const ZZ2L& b)
+{ return a.x == b.x && a.y == b.y; }
+inline long operator!=(const ZZ2L& a, const ZZ2L& b)
+{ return a.x != b.x || a.y != b.y; }
+
+std::ostream& operator<<(std::ostream&, const ZZ2L&);// for printing
+
+struct IDL2L
+// integral ideal aZ + bZ with single precision components
+// same conventions as IDL2
+{
+    long a;// integral basis a, a>0
+    ZZ2L b;// integral basis b, 0<=b.x<a, b.y>0
+    static thread_local long S;// floor(sqrt(D)) (used only for D>0)
+    static thread_local long W;// floor(w) (used only for D>0)
+    static thread_local long W1;// floor(-conj(w)) (used only for D>0)
+    static void init();// copy current values of ZZ2::D, IDL2::S,W,W1
+    // if |ZZ2::D| >= 2**62, raise overflow_error
+    IDL2L() : a(0) {;}
+};
+
+void conv(IDL2L& B, const IDL2& A);// B = A; may raise overflow_error
+void conv(IDL2& B, const IDL2L& A);// B = A
+
+inline void clear(IDL2L& A) { A.a = 0; clear(A.b); }// A = zero ideal
+inline void set(IDL2L& A) { A.a = 1; set(A.b,0,1); }// A = unit ideal
+void conj(IDL2L& B, const IDL2L& A);// conjugate, 0<=b.x<a
+void norm(long& n, const IDL2L& A);// n = norm of ideal A; n>0
+
+inline long IsZero(const IDL2L& A) { return A.a == 0; }// test if A==0
+inline long IsUnit(const IDL2L& A) { return A.a == 1; }// test if A==1
+
+void mul(IDL2L& C, const IDL2L& A, const IDL2L& B);// C = A*B
+void sqr(IDL2L& B, const IDL2L& A);// B = A*A
+void primitive(IDL2L& B, const IDL2L& A);// B = primitive part of A
+
+long cfrac(IDL2L& A, long red=0);
+// one step of reduction algorithm (same as cfrac for IDL2)
+void reduce(IDL2L& B, const IDL2L& A);// B = reduced ideal of A
+long IsEquiv(const IDL2L& A, const IDL2L& B);
+// test if A and B are equivalent ideals
+long IsPrincipal(const IDL2L& A);// test if A is a principal ideal
+
+// test equality, assuming 0<=b.x<a
+inline long operator==(const IDL2L& A, const IDL2L& B)
+{ return A.a == B.a && A.b == B.b; }
+inline long operator!=(const IDL2L& A, const IDL2L& B)
+{ return A.a != B.a || A.b != B.b; }
+
+struct IDL2LHash
+// hash function of ideals, e.g., for std::unordered_set
+{ size_t operator()(const IDL2L& A) const; };
+
+std::ostream& operator<<(std::ostream&, const IDL2L&);// for printing
+
+struct ReducedForms
+// iterator over reduced forms (a,b,c) of discriminant D<0, i.e.,
+// b^2 - 4ac = D, |b| <= a <= c, and b>=0 if |b|==a or a==c,
+// in increasing order of |b|, e.g.,
+//   for(ReducedForms F; F.next();) print(F.a, F.b, F.c);
+// values ac = r^2 + r*(D mod 4) - D4 for b = 2r + (D mod 4)
+// are factored by sieve on segments of r (instead of factoring
+// each value), using two roots of r^2 + r*(D mod 4) - D4 mod p
+// for each prime p, and a = divisor of ac with |b| <= a <= c.
+// assume ZZ2L::D < 0, i.e., IDL2L::init() has been called.
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    Algorithm 5.3.5
+{
+    long a,b,c;// current form
+    long r,s,t;// |b| = 2r + (D mod 4), r <= t <= s = maximum of r
+    long r0;// segment [r0, r0 + length of n)
+    NTL::vec_long P,R,Q;// R[i] = root of ac mod prime P[i]
+    // and Q[i] = next r in sieve by P[i]
+    NTL::vec_long n,m;// ac and its unfactored part for r in segment
+    NTL::vec_long f,k;// f[16*i+j] = j-th prime factor of ac, j < k[i]
+    NTL::vec_long d;// divisors a of ac with |b| <= a <= c
+    long j;// index of next form in d (2*j+1 for negative b)
+    ReducedForms() { init(); }
+    void init();// start with discriminant ZZ2L::D
+    void range(long r1, long r2);
+    // restart with 2*r1 <= |b| - (D mod 4) <= 2*r2, e.g., to split
+    // forms to threads (each with a copy of this object)
+    long next();// move to next form; return 0 if there is no more
+};
+
+struct ICG2L : IDL2L
+// Ideal Class Group in Quadratic fields
+// with single precision components.
+// if an intermediate result overflows, group operations
+// are done by ICG2 and converted back to single precision
+{
+    mutable IDL2L rep,key;// rep = canonical(key), cache of canonical(*this)
+    static thread_local long amax;// Minkowski bound for a
+    static void init();// copy current values of ICG2
+    // if |ZZ2::D| >= 2**62, raise overflow_error
+    static void ClassNum(NTL::ZZ& h);// h = class number
+    static void ClassNum(NTL::ZZ& h, NTL::vec_long& l);
+    // h = class number, l[i] = length of i-th cycle of
+    // reduced ideals for D>0 (l is empty for D<0)
+    static void ClassNumParallel(NTL::ZZ& h, long n=0);
+    // h = class number computed by n threads
+    // (if n<=0, by number of hardware threads)
+};
+
+const IDL2L& canonical(const ICG2L& A);
+// canonical ideal in class of A (same as canonical for ICG2)
+
+inline long operator==(const ICG2L& A, const ICG2L& B)
+// test equivalence of A and B
+{
+    if(ZZ2L::D < 0 || IsZero(A) || IsZero(B)) return IsEquiv(A,B);
+    return canonical(A) == canonical(B);
+}
+inline long operator!=(const ICG2L& A, const ICG2L& B)
+{ return !(A==B); }
+
+size_t hash(const ICG2L& A);
+// hash value of ideal class of A (same as hash for ICG2)
+
+inline long IsUnit(const ICG2L& A)
+{ return IsPrincipal(A); }// test principality of A
+
+inline void inv(ICG2L& B, const ICG2L& A) { conj(B,A); }
+// B = inverse class of A
+
+void mul(ICG2L& C, const ICG2L& A, const ICG2L& B);// C=A*B
+void sqr(ICG2L& B, const ICG2L& A);// B=A*A
+
+inline void operator*=(ICG2L& B, const ICG2L& A) { mul(B,B,A); }// B=B*A
+
+void power(ICG2L& B, const ICG2L& A, long n);// B=A^n (n may be n<0)
+// by signed sliding window (same as power for ICG2)
+
+long generator(NTL::Vec<NTL::Pair<ICG2L, long> >& G,
+               long min=1, long grh=0);
+// generator of class group (same as generator for ICG2)
+// assume ICG2L::init() has been called
+
+#endif // __IDL2L_h__
\ No newline at end of file
@@ -0,0 +1,67 @@
+// uses NTL
+//   http://www.shoup.net/ntl
+
+#ifndef __LRUCache_h__
+#define __LRUCache_h__
+
+#include<NTL/ZZ.h>
+#include<list>
+#include<map>
+#include<utility>
+
+template<class T>
+struct LRUCache
+// cache of values of type T keyed by discriminant D
+// for at most size discriminants (if size<=0, nothing is cached).
+// when cache is full, least recently used entry is discarded.
+// hit and miss count look ups so that efficiency of cache
+// can be checked, e.g., in production runs.
+// caches are declared thread_local, so that no lock is needed.
+{
+    typedef std::list<std::pair<NTL::ZZ, T> > list_type;
+    typedef std::map<NTL::ZZ, typename list_type::iterator> map_type;
+    long size;// maximum number of entries
+    long hit;// number of successful look ups
+    long miss;// number of failed look ups
+    list_type L;// entries, most recently used first
+    map_type M;// index of L by D
+    LRUCache(long n=16) : size(n), hit(0), miss(0) {;}
+    T *find(const NTL::ZZ& D)
+    // return pointer to cached value for D, or 0 if not found
+    {
+        typename map_type::iterator p(M.find(D));
+        if(p == M.end()) { miss++; return 0; }
+        hit++;
+        L.splice(L.begin(), L, p->second);
+        return &L.front().second;
+    }
+    void insert(const NTL::ZZ& D, const T& a)
+    // cache a as value for D
+    {
+        if(size <= 0) return;
+        typename map_type::iterator p(M.find(D));
+        if(p != M.end()) {
+            p->second->second = a;
+            L.splice(L.begin(), L, p->second);
+            return;
+        }
+        L.push_front(std::make_pair(D,a));
+        M[D] = L.begin();
+        while(long(L.size()) > size) {
+            M.erase(L.back().first);
+            L.pop_back();
+        }
+    }
+    void clear() { L.clear(); M.clear(); hit = miss = 0; }
+    // remove all entries and reset statistics
+};
+
+template<class T>
+std::ostream& operator<<(std::ostream& s, const LRUCache<T>& c)
+// print statistics [hit miss number_of_entries]
+{
+    s << '[' << c.hit << ' ' << c.miss << ' ' << c.L.size() << ']';
+    return s;
+}
+
+#endif // __LRUCache_h__
\ No newline at end of file
@@ -73,3 +73,117 @@ void SmithNF(vec_ZZ& D, mat_ZZ& U, const mat_ZZ& A)
     }
     if(n) D[0] = B[0][0];
 }
+
+static void rem_(ZZ& x, const ZZ& a, const ZZ& r)
+// x = a mod r if |a| >= r, else x = a, so that entries smaller
+// than r are kept as they are in the exact algorithm
+// private function, used only internally by SmithNFMod
+{
+    if(NumBits(a) < NumBits(r) || abs(a) < r) x = a;
+    else rem(x,a,r);
+}
+
+static void SmithNFMod(vec_ZZ& D, mat_ZZ *U, const mat_ZZ& A, const ZZ& R)
+// Smith normal form modulo R (multiple of |det(A)|).
+// entries of B exceeding R are reduced modulo R, and after
+// k-th diagonal element D[k] is found, R is replaced by R/D[k],
+// since determinant of remaining (k x k) block divides R/D[k].
+// if U!=0, column operations are applied to U modulo R,
+// otherwise U is skipped (for invariant factors only).
+// private function, used only internally by SmithNF
+// reference:
+//   H. Cohen, "A Course in Computational Algebraic Number Theory"
+//     Algorithm 2.4.14
+{
+    long i,j,k,l,n(A.NumRows());
+    ZZ x,y,u,v,d,t,r(R);
+    mat_ZZ B(A);
+    D.SetLength(n);
+    if(U) ident(*U,n);
+    for(i=0; i<n; i++)
+        for(j=0; j<n; j++) rem_(B[i][j], B[i][j], r);
+    for(k=n-1; k>=0; k--) {
+    a:  ;// eliminate column
+        for(i=k-1; i>=0; i--) {
+            if(IsZero(B[i][k])) continue;
+            XGCD(d, x, y, B[i][k], B[k][k]);
+            div(u, B[k][k], d);
+            div(v, B[i][k], d);
+            B[k][k] = d;
+            clear(B[i][k]);
+            for(j=k-1; j>=0; j--) {
+                mul(t, x, B[i][j]);
+                MulAddTo(t, y, B[k][j]);
+                B[i][j] *= u;
+                MulSubFrom(B[i][j], v, B[k][j]);
+                rem_(B[i][j], B[i][j], r);
+                rem_(B[k][j], t, r);
+            }
+        }
+    b:  ;// eliminate row
+        for(l=0, j=k-1; j>=0; j--) {
+            if(IsZero(B[k][j])) continue;
+            l = 1;
+            XGCD(d, x, y, B[k][j], B[k][k]);
+            div(u, B[k][k], d);
+            div(v, B[k][j], d);
+            B[k][k] = d;
+            clear(B[k][j]);
+            for(i=k-1; i>=0; i--) {
+                mul(t, x, B[i][j]);
+                MulAddTo(t, y, B[i][k]);
+                B[i][j] *= u;
+                MulSubFrom(B[i][j], v, B[i][k]);
+                rem_(B[i][j], B[i][j], r);
+                rem_(B[i][k], t, r);
+            }
+            if(!U) continue;
+            for(i=0; i<n; i++) {
+                mul(t, v, (*U)[j][i]);
+                MulAddTo(t, u, (*U)[k][i]);
+                (*U)[j][i] *= y;
+                MulSubFrom((*U)[j][i], x, (*U)[k][i]);
+                rem_((*U)[j][i], (*U)[j][i], R);
+                rem_((*U)[k][i], t, R);
+            }
+        }
+        if(l) goto a;// column k was changed
+        GCD(B[k][k], B[k][k], r);// by adding R*(k-th unit vector)
+        for(i=0; i<k; i++) {
+            for(j=0; j<k; j++) {
+                if(divide(B[i][j], B[k][k])) continue;
+                for(j=0; j<k; j++) B[k][j] = B[i][j];
+                goto b;
+            }
+        }
+        D[k] = B[k][k];
+        r /= D[k];
+    }
+}
+
+void SmithNF(vec_ZZ& D, mat_ZZ& U, const mat_ZZ& A, const ZZ& R)
+// input:
+//   A = non-singular square matrix of integers
+//   R = positive multiple of |det(A)|
+// output:
+//   D = diagonal elements of Smith normal form S of A
+//       in decreasing order
+//   U = square matrix of integers such that
+//       A=VSU (mod R), for some V, det(V)=1,
+//       and |U[i][j]| < R
+// entries are kept to the size of R
+{ SmithNFMod(D, &U, A, R); }
+
+void SmithNF(vec_ZZ& D, const mat_ZZ& A, const ZZ& R)
+// same as above, but U is not computed
+{ SmithNFMod(D, 0, A, R); }
+
+void SmithNF(vec_ZZ& D, const mat_ZZ& A)
+// D = diagonal elements of Smith normal form of A
+// computed modulo |det(A)| (by NTL determinant)
+{
+    ZZ R;
+    determinant(R,A);
+    abs(R,R);
+    SmithNFMod(D, 0, A, R);
+}
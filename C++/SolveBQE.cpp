@@ -96,8 +96,9 @@ long SolveBQE(mat_ZZ & xy, const BQF& F, const ZZ& N, long M)
     set(q,r,f);
     A += q;
     IDL2FromNorm(J,n);
+    PrincipalCycle P;// shared by all principal ideal tests
     for(i=0; i<J.length(); i++) {
-        if(!IsPrincipal(q, J[i]*=A)) continue;
+        if(!IsPrincipal(q, J[i]*=A, P)) continue;
         norm(s,q);
         if(sign(s) != sign(n)) {
             if(sgn > 0) continue;
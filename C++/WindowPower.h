@@ -0,0 +1,126 @@
+// uses NTL
+//   http://www.shoup.net/ntl
+
+#ifndef __WindowPower_h__
+#define __WindowPower_h__
+
+#include<NTL/ZZ.h>
+#include<NTL/vector.h>
+
+inline long WindowDigits(long *d, long& w, unsigned long m, long naf)
+// d[i] = digits of m = sum d[i]*2^i, d[i] is odd or zero
+// if naf==1, |d[i]| < 2^(w-1) (width-w NAF),
+// else 0 <= d[i] < 2^w (sliding window of width w)
+// w = window width (2 <= w <= 4) chosen by size of m
+// d must have length >= 8*sizeof(long)+1
+// return number of digits
+// private function, used only internally by WindowPower and NAFPower
+{
+    long k(NTL::NumBits(long(m>>1))+1);
+    w = (k<=8 ? 2 : k<=24 ? 3 : 4);
+    for(k=0; m; k++, m>>=1) {
+        if(m&1) {
+            d[k] = m & ((1L<<w)-1);
+            if(naf && d[k] >= 1L<<(w-1)) d[k] -= 1L<<w;
+            m -= d[k];
+        }
+        else d[k] = 0;
+    }
+    return k;
+}
+
+template<class T>
+void WindowPower(T& B, const T& A, long n)
+// B = A^n by left-to-right sliding window method
+// with precomputed odd powers A, A^3, A^5, ...
+// assume n>=0.
+// T must suport following funcitons:
+//   set(T& a) : a is set to unit element of T
+//   mul(T& c, T& a, T& b) : c = a*b
+//   sqr(T& b, T& a) : b = a*a
+// reference: H. Cohen
+//   "A Course in Computational Algebraic Number Theory"
+//    section 1.2
+{
+    long i,k,w,d[8*sizeof(long)+1];
+    if(n<=0) { set(B); return; }
+    NTL::Vec<T> P;// odd powers of A
+    k = WindowDigits(d,w,n,0);
+    P.SetLength(1L<<(w-1));
+    P[0] = A;
+    if(P.length() > 1) {
+        T A2;
+        sqr(A2, A);
+        for(i=1; i<P.length(); i++) mul(P[i], P[i-1], A2);
+    }
+    B = P[d[--k]>>1];
+    while(k--) {
+        sqr(B,B);
+        if(d[k]) mul(B, B, P[d[k]>>1]);
+    }
+}
+
+template<class T>
+void NAFPower(T& B, const T& A, const long *d, long k, long w, long neg)
+// B = A^(+-m) where d[i] (0<=i<k) are signed digits of m
+// of width w, and - is taken if neg!=0
+// private function, used only internally by NAFPower
+{
+    long i,j;
+    NTL::Vec<T> P,Q;// odd powers of A and their inverses
+    P.SetLength(1L<<(w-2));
+    Q.SetLength(P.length());
+    if(neg) inv(P[0],A); else P[0] = A;
+    if(P.length() > 1) {
+        T A2;
+        sqr(A2, P[0]);
+        for(i=1; i<P.length(); i++) mul(P[i], P[i-1], A2);
+    }
+    for(i=0; i<P.length(); i++) inv(Q[i], P[i]);
+    B = P[d[--k]>>1];// top digit is positive
+    while(k--) {
+        sqr(B,B);
+        if((j = d[k]) > 0) mul(B, B, P[j>>1]);
+        else if(j < 0) mul(B, B, Q[(-j)>>1]);
+    }
+}
+
+template<class T>
+void NAFPower(T& B, const T& A, long n)
+// B = A^n by signed digits (width-w NAF)
+// with precomputed odd powers A, A^3, A^5, ... and their inverses.
+// n may be n<0.
+// T must suport functions required by WindowPower and
+//   inv(T& b, T& a) : b = a^(-1) (assume inv is fast)
+{
+    long k,w,d[8*sizeof(long)+1];
+    unsigned long m(n<0 ? -(unsigned long)n : n);
+    if(m==0) { set(B); return; }
+    k = WindowDigits(d,w,m,1);
+    NAFPower(B, A, d, k, w, n<0);
+}
+
+template<class T>
+void NAFPower(T& B, const T& A, const NTL::ZZ& n)
+// same as above for n of multiple precision.
+// window width w = 4 or 5 is chosen by size of n
+{
+    if(n.SinglePrecision()) { NAFPower(B, A, NTL::conv<long>(n)); return; }
+    long j,w;
+    NTL::ZZ m;
+    NTL::Vec<long> d;// signed digits of |n|
+    abs(m,n);
+    w = (NTL::NumBits(m) <= 128 ? 4 : 5);
+    for(; !IsZero(m); m >>= 1) {
+        if(IsOdd(m)) {
+            j = trunc_long(m,w);
+            if(j >= 1L<<(w-1)) j -= 1L<<w;
+            m -= j;
+        }
+        else j = 0;
+        d.append(j);
+    }
+    NAFPower(B, A, d.elts(), d.length(), w, sign(n)<0);
+}
+
+#endif // __WindowPower_h__
\ No newline at end of file
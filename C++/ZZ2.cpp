@@ -3,11 +3,16 @@
 
 #include "ZZ2.h"
 #include<exception>
+#include<cmath>
 using namespace NTL;
 
-ZZ ZZ2::D;// discriminant
-ZZ ZZ2::D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
-long ZZ2::Dm4;// D mod 4
+thread_local ZZ ZZ2::D;// discriminant
+thread_local ZZ ZZ2::D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
+thread_local long ZZ2::Dm4;// D mod 4
+
+// temporaries of arithmetic are thread local registers
+// (NTL_ZZRegister and NTL_TLS_LOCAL) so that they are
+// allocated only once per thread and reused in later calls
 
 void ZZ2::init(const ZZ& D_) {// set discriminant 
     long d(D_%4);
@@ -16,6 +21,12 @@ void ZZ2::init(const ZZ& D_) {// set discriminant
     D4 >>= 2;
 }
 
+ZZ2Context::ZZ2Context(const ZZ& D_) {// context for D_
+    ZZ2Push p;
+    ZZ2::init(D_);
+    *this = ZZ2Context();
+}
+
 ZZ2& ZZ2::operator=(const ZZ& a) { x=a; clear(y); return *this; }
 ZZ2& ZZ2::operator=(long a) { x=a; clear(y); return *this; }
 
@@ -42,7 +53,7 @@ void set(ZZ2& a, const ZZ& x, long y) { a.x = x; a.y = y; }// a = x+yw
 void set(ZZ2& a, long x, const ZZ& y) { a.x = x; a.y = y; }// a = x+yw
 
 void norm(ZZ& x, const ZZ2& a) {// assume &x!=&a.x and &x!=&a.y
-    ZZ s;
+    NTL_ZZRegister(s);
     if(ZZ2::Dm4) {
         add(x, a.x, a.y);
         x *= a.x;
@@ -77,14 +88,14 @@ void mul_w(ZZ2& b, const ZZ2& a) {// b = a*w
 }
 
 long IsUnit(const ZZ2& a) {// test if a==1
-    ZZ s;
+    NTL_ZZRegister(s);
     norm(s,a);
     abs(s,s);
     return IsOne(s);
 }
 
 long IsAssoc(const ZZ2& a, const ZZ2& b) {// test if a/b is unit
-    ZZ2 q;
+    NTL_TLS_LOCAL(ZZ2, q);
     return div(q,a,b) && IsUnit(q);
 }
 
@@ -99,7 +110,10 @@ void sub(ZZ2& c, const ZZ2& a, const ZZ2& b) {// c=a-b
 }
 
 void mul(ZZ2& c, const ZZ2& a, const ZZ2& b) {// c=a*b
-    ZZ s,t,u,v;
+    NTL_ZZRegister(s);
+    NTL_ZZRegister(t);
+    NTL_ZZRegister(u);
+    NTL_ZZRegister(v);
     mul(s, a.x, b.x);
     mul(t, a.y, b.y);
     add(u, a.x, a.y);
@@ -122,7 +136,9 @@ void mul(ZZ2& c, const ZZ& b, const ZZ2& a) {// c=a*b
 }
 
 void sqr(ZZ2& b, const ZZ2& a) {// b = a*a
-    ZZ s,t,u;
+    NTL_ZZRegister(s);
+    NTL_ZZRegister(t);
+    NTL_ZZRegister(u);
     sqr(s, a.x);
     sqr(t, a.y);
     mul(u, a.x, a.y);
@@ -133,8 +149,8 @@ void sqr(ZZ2& b, const ZZ2& a) {// b = a*a
 }
 
 long div(ZZ2& q, const ZZ2& a, const ZZ2& b) {// q = floor(a/b)
-    ZZ s;
-    ZZ2 c;
+    NTL_ZZRegister(s);
+    NTL_TLS_LOCAL(ZZ2, c);
     norm(s,b);
     conj(c,b);
     c *= a;
@@ -142,7 +158,8 @@ long div(ZZ2& q, const ZZ2& a, const ZZ2& b) {// q = floor(a/b)
 }
 
 long div(ZZ2& q, const ZZ2& a, const ZZ& b) {// q = floor(a/b)
-    ZZ s,t;
+    NTL_ZZRegister(s);
+    NTL_ZZRegister(t);
     if(!divide(s, a.x, b) || !divide(t, a.y, b))
         return 0;
     q.x = s;
@@ -151,8 +168,8 @@ long div(ZZ2& q, const ZZ2& a, const ZZ& b) {// q = floor(a/b)
 }
 
 long div(const ZZ2& a, const ZZ2& b) {// test if b divides a
-    ZZ s;
-    ZZ2 c;
+    NTL_ZZRegister(s);
+    NTL_TLS_LOCAL(ZZ2, c);
     norm(s,b);
     conj(c,b);
     c *= a;
@@ -174,6 +191,44 @@ void power(ZZ2& b, const ZZ2& a, long n) {// b=a^n, assume n>=0
     }
 }
 
+long sign(const ZZ2& a)
+// sign of a = (s + y*sqrt(D))/2, s = 2*x + y*(D mod 4)
+{
+    NTL_ZZRegister(s);
+    NTL_ZZRegister(t);
+    long i(sign(a.y));
+    LeftShift(s, a.x, 1);
+    if(ZZ2::Dm4) s += a.y;
+    if(sign(s) == i || i == 0) return sign(s);
+    if(IsZero(s)) return i;
+    sqr(t, a.y);
+    t *= ZZ2::D;
+    sqr(s, s);
+    return (s > t ? -i : i);
+}
+
+double log(const ZZ2& a)
+// log|a| = log|s + y*sqrt(D)| - log(2)
+// if s and y have opposite signs, log|a| = log|norm(a)| - log|conj(a)|
+// to avoid cancellation
+{
+    NTL_ZZRegister(s);
+    NTL_ZZRegister(n);
+    double u,v;
+    if(sign(ZZ2::D) < 0) { norm(n,a); return log(n)/2; }
+    LeftShift(s, a.x, 1);
+    if(ZZ2::Dm4) s += a.y;
+    if(IsZero(a.y)) return log(abs(a.x));
+    v = log(abs(a.y)) + log(ZZ2::D)/2;// log|y*sqrt(D)|
+    if(IsZero(s)) return v - log(2.);
+    u = log(abs(s));
+    if(u < v) std::swap(u,v);
+    v = u + log1p(exp(v-u)) - log(2.);// log(|s| + |y|*sqrt(D)) - log(2)
+    if(sign(s) == sign(a.y)) return v;
+    norm(n,a);
+    return log(abs(n)) - v;
+}
+
 
 std::ostream& operator<<(std::ostream& s, const ZZ2& a) {
     s << '[' << a.x << ' ' << a.y << ']';
@@ -15,9 +15,10 @@ struct ZZ2
 //    section 41 (in Japanese)
 {
     NTL::ZZ x,y;// components of x+yw
-    static NTL::ZZ D;// discriminant
-    static NTL::ZZ D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
-    static long Dm4; // D mod 4 (0 or 1)
+    // discriminant is local to each thread
+    static thread_local NTL::ZZ D;// discriminant
+    static thread_local NTL::ZZ D4;// D/4 or (D-1)/4 for D==0,1(mod 4)
+    static thread_local long Dm4; // D mod 4 (0 or 1)
     static void init(const NTL::ZZ& D);// set discriminant D
     // if D!=0,1 (mod 4), raise runtime_error
     static void init(long D) { init(NTL::ZZ(D)); }
@@ -31,12 +32,25 @@ struct ZZ2
     ZZ2& operator=(long a);// x=a, y=0
 };
 
-struct ZZ2Push {
+struct ZZ2Context
+// discriminant context D,D4,Dm4 of ZZ2.
+// may be copied to other threads and set there by restore()
+{
     NTL::ZZ D,D4;
     long Dm4;
-    ZZ2Push() : D(ZZ2::D), D4(ZZ2::D4), Dm4(ZZ2::Dm4) {;}
+    ZZ2Context() : D(ZZ2::D), D4(ZZ2::D4), Dm4(ZZ2::Dm4) {;}
     // save current values of D,D4,Dm4
-    ~ZZ2Push() { ZZ2::D=D; ZZ2::D4=D4; ZZ2::Dm4=Dm4; }
+    explicit ZZ2Context(const NTL::ZZ& D);
+    // context for discriminant D (current values are unchanged)
+    void restore() const { ZZ2::D=D; ZZ2::D4=D4; ZZ2::Dm4=Dm4; }
+    // set D,D4,Dm4 of current thread to saved values
+};
+
+struct ZZ2Push : ZZ2Context {
+    ZZ2Push() {;}// save current values of D,D4,Dm4
+    ZZ2Push(const ZZ2Context& c) { c.restore(); }
+    // save current values and set context c
+    ~ZZ2Push() { restore(); }
     // restore D,D4,Dm4 when this object is destructed
 };
 
@@ -77,6 +91,13 @@ long div(const ZZ2& a, const NTL::ZZ& b);
 
 void power(ZZ2& b, const ZZ2& a, long e);// b = a**e (e>=0)
 
+long sign(const ZZ2& a);
+// sign of a as real number, assume D>0 and sqrt(D)>0
+
+double log(const ZZ2& a);
+// log|a|; if D>0, a is regarded as real number (sqrt(D)>0)
+// assume a!=0
+
 inline long operator==(const ZZ2& a, const ZZ2& b)// test if a==b
 { return a.x == b.x && a.y == b.y; }
 inline long operator!=(const ZZ2& a, const ZZ2& b)// test if a!=b
@@ -3,6 +3,7 @@
 
 #include "ZZFactoring.h"
 #include<exception>
+#include<algorithm>
 using namespace NTL;
 
 #define TRYDIV_BOUND (1<<16)
@@ -109,6 +110,8 @@ void factor(Vec<Pair<ZZ, long> >& f, const ZZ& n)
     factor_(f,m);
 }
 
+thread_local LRUCache<Pair<ZZ, ZZ> > ConductorCache;
+
 void conductor(ZZ& f, ZZ& d, const ZZ& D)
 // D = discriminant, D==0 or 1 (mod 4)
 // return f,d such that
@@ -119,6 +122,8 @@ void conductor(ZZ& f, ZZ& d, const ZZ& D)
 {
     if(IsZero(D)) { clear(f); clear(d); return; }
     if(&d==&D) { conductor(f,d,ZZ(D)); return; }
+    Pair<ZZ, ZZ> *c(ConductorCache.find(D));
+    if(c) { f = c->a; d = c->b; return; }
     Vec<Pair<ZZ, long> > p;
     factor(p,D);
     set(d);
@@ -128,6 +133,7 @@ void conductor(ZZ& f, ZZ& d, const ZZ& D)
     div(f,D,d);
     SqrRoot(f,f);
     if(d%4 > 1) { d<<=2; f>>=1; }
+    ConductorCache.insert(D, Pair<ZZ, ZZ>(f,d));
 }
 
 long IsFundDisc(const ZZ& D)
@@ -163,4 +169,38 @@ void divisor(vec_ZZ& d, const ZZ& n)
         }
     }
     qsort((void *)d.data(), d.length(), sizeof(ZZ), cmp);
+}
+
+void divisor(vec_long& d, long n)
+// d = vector of positive divisors of |n|
+// d[0] = 1 and d[i] increases
+{
+    long i,j,k,l,m(n<0 ? -n : n),p,q;
+    Vec<Pair<long, long> > f;
+    PrimeSeq ps;
+    while((p = ps.next()) <= TRYDIV_BOUND && p <= m/p) {
+        for(j=0; m%p == 0; j++) m/=p;
+        if(j) f.append(Pair<long, long>(p,j));
+    }
+    if(m > 1) {
+        if(m/TRYDIV_BOUND < TRYDIV_BOUND || ProbPrime(m))
+            f.append(Pair<long, long>(m,1));
+        else {
+            Vec<Pair<ZZ, long> > g;
+            factor_(g, ZZ(m));
+            for(i=0; i<g.length(); i++)
+                f.append(Pair<long, long>(conv<long>(g[i].a), g[i].b));
+        }
+    }
+    d.SetLength(1);
+    d[0] = 1;
+    for(i=0; i<f.length(); i++) {
+        l = d.length();
+        d.SetLength(l*(f[i].b + 1));
+        for(j=l, q=1; j<d.length();) {
+            q *= f[i].a;
+            for(k=0; k<l; k++) d[j++] = d[k]*q;
+        }
+    }
+    std::sort(d.data(), d.data() + d.length());
 }
\ No newline at end of file
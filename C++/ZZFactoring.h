@@ -2,7 +2,9 @@
 #define __ZZFactoring_h__
 
 #include<NTL/vec_ZZ.h>
+#include<NTL/vec_long.h>
 #include<NTL/pair.h>
+#include "LRUCache.h"
 
 void factor(NTL::Vec<NTL::Pair<NTL::ZZ, long> >& f, const NTL::ZZ& n);
 // n = integer
@@ -14,6 +16,10 @@ void divisor(NTL::vec_ZZ& d, const NTL::ZZ& n);
 // d = vector of positive divisors of n
 // d[0] = 1 and d[i] increases
 
+void divisor(NTL::vec_long& d, long n);
+// d = vector of positive divisors of |n| (n!=0)
+// d[0] = 1 and d[i] increases
+
 void conductor(NTL::ZZ& f, NTL::ZZ& d, const NTL::ZZ& D);
 // D = discriminant, D==0 or 1 (mod 4)
 // return f,d such that f**2 divide D,
@@ -22,6 +28,9 @@ void conductor(NTL::ZZ& f, NTL::ZZ& d, const NTL::ZZ& D);
 // if d==0 (mod 4), d/4 is square-free and
 //                  d/4 == 2 or 3 (mod 4)
 
+extern thread_local LRUCache<NTL::Pair<NTL::ZZ, NTL::ZZ> > ConductorCache;
+// cache of (f,d) computed by conductor
+
 long IsFundDisc(const NTL::ZZ& D);
 // test if D is fundamental discriminant
 
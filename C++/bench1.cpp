@@ -0,0 +1,161 @@
+// benchmark of ideal arithmetic in IDL2.cpp
+// against generic hermite normal form of lattice
+#include "IDL2.h"
+#include<NTL/mat_ZZ.h>
+using namespace NTL;
+
+void HermitNF(mat_ZZ&, const mat_ZZ&);
+
+void hnf(IDL2& C, mat_ZZ& W) {// old method
+    HermitNF(W,W);
+    C.a = W[0][0];
+    C.b.x = W[1][0];
+    C.b.y = W[1][1];
+}
+
+void hnf_conv(IDL2& A, const ZZ2& a) {// A = (a)
+    ZZ2 b;
+    mat_ZZ W;
+    W.SetDims(2,2);
+    mul_w(b,a);
+    W[0][0] = a.x;
+    W[0][1] = a.y;
+    W[1][0] = b.x;
+    W[1][1] = b.y;
+    hnf(A,W);
+}
+
+void hnf_add(IDL2& C, const IDL2& A, const IDL2& B) {// C = A+B
+    mat_ZZ W;
+    W.SetDims(4,2);
+    W[0][0] = A.a;
+    W[1][0] = A.b.x;
+    W[1][1] = A.b.y;
+    W[2][0] = B.a;
+    W[3][0] = B.b.x;
+    W[3][1] = B.b.y;
+    hnf(C,W);
+}
+
+void hnf_mul(IDL2& C, const IDL2& A, const IDL2& B) {// C = A*B
+    ZZ2 s;
+    mat_ZZ W;
+    W.SetDims(4,2);
+    mul(W[0][0], A.a, B.a);
+    mul(W[1][0], A.a, B.b.x);
+    mul(W[1][1], A.a, B.b.y);
+    mul(W[2][0], A.b.x, B.a);
+    mul(W[2][1], A.b.y, B.a);
+    mul(s, A.b, B.b);
+    W[3][0] = s.x;
+    W[3][1] = s.y;
+    hnf(C,W);
+}
+
+void hnf_sqr(IDL2& B, const IDL2& A) {// B = A*A
+    ZZ2 s;
+    mat_ZZ W;
+    W.SetDims(3,2);
+    sqr(W[0][0], A.a);
+    mul(W[1][0], A.a, A.b.x);
+    mul(W[1][1], A.a, A.b.y);
+    sqr(s, A.b);
+    W[2][0] = s.x;
+    W[2][1] = s.y;
+    hnf(B,W);
+}
+
+void SetSingular(IDL2& A, long q)
+// A = qZ + (b+w)Z with 2b+Dm4 = 0 mod q,
+// which is not invertible if q is odd and q^2 divides D
+{
+    A.a = q;
+    if(ZZ2::Dm4) A.b.x = (q-1)/2; else clear(A.b.x);
+    set(A.b.y);
+}
+
+void bench(long e, long f, long n)
+// compare ideal arithmetic with old method for current D
+// and n ideals of norm about D; if f>1, f^2 divides D and
+// some of ideals are multiplied by non-invertible ideals
+{
+    long i,j,q,m(0);
+    static const long s[] = {3,5,7};
+    ZZ p(abs(ZZ2::D));
+    PrimeSeq ps;
+    // ideals of norm about D, some of them non-primitive
+    Vec<IDL2> A;
+    Vec<ZZ2> a;
+    A.SetLength(n);
+    a.SetLength(n);
+    for(i=0; i<n; ) {
+        q = ps.next();
+        if(f%q == 0 || IDL2::kron(q) < 0) continue;
+        SetPrime(A[i], q);
+        if(IsOdd(q)) conj(A[i], A[i]);
+        power(A[i], A[i], e*10/3/NumBits(q));
+        if(i%4 == 0) A[i] *= ZZ(q);
+        if(i%4 == 2 && f%s[m%3] == 0) {
+            IDL2 S;
+            SetSingular(S, s[m++%3]);
+            hnf_mul(A[i], A[i], S);
+        }
+        RandomBnd(a[i].x, p);
+        RandomBnd(a[i].y, p);
+        i++;
+    }
+    IDL2 B,C;
+    double t[9];
+    t[0] = GetTime();
+    for(i=0; i<n; i++) for(j=0; j<n; j++) mul(B, A[i], A[j]);
+    t[1] = GetTime();
+    for(i=0; i<n; i++) for(j=0; j<n; j++) hnf_mul(C, A[i], A[j]);
+    t[2] = GetTime();
+    for(j=0; j<n; j++) for(i=0; i<n; i++) sqr(B, A[i]);
+    t[3] = GetTime();
+    for(j=0; j<n; j++) for(i=0; i<n; i++) hnf_sqr(C, A[i]);
+    t[4] = GetTime();
+    for(i=0; i<n; i++) for(j=0; j<n; j++) add(B, A[i], A[j]);
+    t[5] = GetTime();
+    for(i=0; i<n; i++) for(j=0; j<n; j++) hnf_add(C, A[i], A[j]);
+    t[6] = GetTime();
+    for(j=0; j<n; j++) for(i=0; i<n; i++) conv(B, a[i]);
+    t[7] = GetTime();
+    for(j=0; j<n; j++) for(i=0; i<n; i++) hnf_conv(C, a[i]);
+    t[8] = GetTime();
+    for(i=0; i<n; i++) {
+        for(j=0; j<n; j++) {
+            mul(B, A[i], A[j]); hnf_mul(C, A[i], A[j]);
+            if(B!=C) Error("mul");
+            add(B, A[i], A[j]); hnf_add(C, A[i], A[j]);
+            if(B!=C) Error("add");
+        }
+        sqr(B, A[i]); hnf_sqr(C, A[i]);
+        if(B!=C) Error("sqr");
+        conv(B, a[i]); hnf_conv(C, a[i]);
+        if(B!=C) Error("conv");
+    }
+    std::cout << (sign(ZZ2::D)<0 ? "D=-" : "D=") << "10^" << e;
+    if(f>1) std::cout << '*' << f << "^2";
+    std::cout << " mul " << t[1]-t[0] << ' ' << t[2]-t[1];
+    std::cout << " sqr " << t[3]-t[2] << ' ' << t[4]-t[3];
+    std::cout << " add " << t[5]-t[4] << ' ' << t[6]-t[5];
+    std::cout << " conv " << t[7]-t[6] << ' ' << t[8]-t[7];
+    std::cout << std::endl;
+}
+
+main() {
+    long e, k, n(200);
+    ZZ p;
+    for(e=20; e<=320; e*=2) {
+        power(p, 10, e);
+        for(k=-1; k<=1; k+=2) {
+            do NextPrime(p, p+1); while(p%4 != (k<0 ? 3:1));
+            IDL2::init(k*p);
+            bench(e, 1, n);
+            // non-fundamental discriminant D = k*p*105^2
+            IDL2::init(k*p*105*105);
+            bench(e, 105, n);
+        }
+    }
+}
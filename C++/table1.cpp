@@ -3,8 +3,15 @@ using namespace NTL;
 
 main() {
     long d, d1(-1000), d2(d1-50), i;
-    ZZ h;
+    ZZ h,k;
     Vec<Pair<ICG2, long> > G;
+    for(d=-3; d>d1; d--) {// check ClassNumBSGS from D=-3,-4
+        try { ICG2::init(d); }
+        catch(std::exception) { continue; }
+        ICG2::ClassNumBSGS(k,1);
+        ICG2::ClassNum(h);
+        if(k!=h) Error("k!=h");
+    }
     for(d=d1; d>=d2; d--) {
         try { ICG2::init(d); }
         catch(std::exception) { continue; }